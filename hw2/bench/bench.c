@@ -0,0 +1,185 @@
+/*
+ * DTMF generation and detection benchmarks.
+ *
+ *   make bench && bin/dtmf_bench [SECONDS]
+ *
+ * Each case is run BENCH_REPEAT times in-process and the fastest run is
+ * reported, one tab-separated line per case:
+ *
+ *   case  mode  block  noise  samples  seconds  msamples/s  events_in  events_out
+ *
+ * The columns never change, so that successive runs can be compared with
+ * diff or loaded into a spreadsheet.  SECONDS (default 600) is the length of
+ * the synthesized input used by the generate and detect cases.  The "dense"
+ * case uses events only a little longer than MIN_DTMF_DURATION separated by
+ * equally short gaps, which stresses both the event parser and the detector's
+ * state machine, and shows how many events each block size manages to find.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "const.h"
+#include "audio.h"
+#include "dtmf.h"
+
+#define BENCH_REPEAT 3
+#define BENCH_NOISE_FILE "/tmp/dtmf_bench_noise.au"
+
+/* Events of 35 ms every 70 ms: just over MIN_DTMF_DURATION */
+#define DENSE_EVENT_SAMPLES 280
+
+static const char bench_symbols[] = "0123456789ABCD*#";
+static const int bench_blocks[] = {10, 25, 50, 100, 205, 500, 1000};
+
+static double bench_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Write an event script into a memory buffer: events of the given length
+ * separated by gaps of the same length, cycling through all the symbols.
+ */
+static char *bench_events(uint32_t length, uint32_t event, size_t *sizep, int *countp) {
+	char *buf = NULL;
+	FILE *f = open_memstream(&buf, sizep);
+	int n = 0;
+	for (uint32_t start = 0; start + event <= length; start += 2 * event, n++) {
+		fprintf(f, "%u\t%u\t%c\n", start, start + event, bench_symbols[n % 16]);
+	}
+	fclose(f);
+	*countp = n;
+	return buf;
+}
+
+/*
+ * Generate audio from an event script, either into a memory buffer or,
+ * if audiop is NULL, to /dev/null.  Returns the time taken.
+ */
+static double bench_generate(char *events, size_t events_size, uint32_t length,
+                             char **audiop, size_t *audio_sizep) {
+	FILE *in = fmemopen(events, events_size, "r");
+	FILE *out = audiop ? open_memstream(audiop, audio_sizep) : fopen("/dev/null", "w");
+	double t = bench_now();
+	if (dtmf_generate(in, out, length) == EOF) {
+		fprintf(stderr, "dtmf_generate failed\n");
+		exit(EXIT_FAILURE);
+	}
+	fflush(out);
+	t = bench_now() - t;
+	fclose(in);
+	fclose(out);
+	return t;
+}
+
+/*
+ * Run detection on audio in memory, returning the time taken and storing
+ * the number of events found.
+ */
+static double bench_detect(char *audio, size_t audio_size, int *eventsp) {
+	char *text = NULL;
+	size_t text_size = 0;
+	FILE *in = fmemopen(audio, audio_size, "r");
+	FILE *out = open_memstream(&text, &text_size);
+	double t = bench_now();
+	if (dtmf_detect(in, out) == EOF) {
+		fprintf(stderr, "dtmf_detect failed\n");
+		exit(EXIT_FAILURE);
+	}
+	fflush(out);
+	t = bench_now() - t;
+	fclose(in);
+	fclose(out);
+
+	int n = 0;
+	for (size_t i = 0; i < text_size; i++) {
+		n += text[i] == '\n';
+	}
+	free(text);
+	*eventsp = n;
+	return t;
+}
+
+static void bench_report(const char *name, const char *mode, int block, int noise,
+                         uint32_t samples, double seconds, int events_in, int events_out) {
+	printf("%s\t%s\t%d\t%d\t%u\t%.6f\t%.3f\t%d\t%d\n", name, mode, block, noise,
+	       samples, seconds, samples / seconds / 1e6, events_in, events_out);
+}
+
+/*
+ * Benchmark generation of the script, and then detection of the generated
+ * audio at every block size, in both precisions.
+ */
+static void bench_case(const char *name, uint32_t length, uint32_t event, int noise) {
+	size_t events_size, audio_size;
+	int events_in;
+	char *events = bench_events(length, event, &events_size, &events_in);
+	char *audio = NULL;
+
+	noise_file = noise ? BENCH_NOISE_FILE : NULL;
+	noise_level = noise ? -10 : 0;
+	double best = 1e30;
+	for (int r = 0; r < BENCH_REPEAT; r++) {
+		double t = bench_generate(events, events_size, length, NULL, NULL);
+		best = t < best ? t : best;
+	}
+	bench_report(name, "generate", 0, noise, length, best, events_in, events_in);
+	bench_generate(events, events_size, length, &audio, &audio_size);
+
+	for (int fixed = 0; fixed <= 1; fixed++) {
+		for (size_t b = 0; b < sizeof(bench_blocks) / sizeof(bench_blocks[0]); b++) {
+			int events_out = 0;
+			block_size = bench_blocks[b];
+			global_options = DETECT_OPTION | (fixed ? FIXED_OPTION : 0);
+			best = 1e30;
+			for (int r = 0; r < BENCH_REPEAT; r++) {
+				double t = bench_detect(audio, audio_size, &events_out);
+				best = t < best ? t : best;
+			}
+			bench_report(name, fixed ? "detect-q" : "detect", block_size, noise,
+			             length, best, events_in, events_out);
+		}
+	}
+	free(audio);
+	free(events);
+}
+
+int main(int argc, char **argv) {
+	int seconds = argc > 1 ? atoi(argv[1]) : 600;
+	if (seconds <= 0) {
+		fprintf(stderr, "usage: %s [SECONDS]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	uint32_t length = seconds * AUDIO_FRAME_RATE;
+
+	// white noise as long as the input
+	FILE *out = fopen(BENCH_NOISE_FILE, "w");
+	AUDIO_HEADER header = {AUDIO_MAGIC, AUDIO_DATA_OFFSET, length * AUDIO_BYTES_PER_SAMPLE,
+	                       PCM16_ENCODING, AUDIO_FRAME_RATE, AUDIO_CHANNELS};
+	if (out == NULL || audio_write_header(out, &header) == EOF) {
+		fprintf(stderr, "cannot write %s\n", BENCH_NOISE_FILE);
+		return EXIT_FAILURE;
+	}
+	uint32_t seed = 1;
+	for (uint32_t i = 0; i < length; i++) {
+		seed = seed * 1103515245 + 12345;
+		audio_write_sample(out, (int16_t)(seed >> 16));
+	}
+	if (fclose(out) == EOF) {
+		fprintf(stderr, "cannot write %s\n", BENCH_NOISE_FILE);
+		return EXIT_FAILURE;
+	}
+
+	printf("# case\tmode\tblock\tnoise\tsamples\tseconds\tmsamples/s\tevents_in\tevents_out\n");
+	bench_case("long", length, AUDIO_FRAME_RATE / 2, 0);
+	bench_case("long", length, AUDIO_FRAME_RATE / 2, 1);
+	bench_case("dense", length, DENSE_EVENT_SAMPLES, 0);
+	bench_case("dense", length, DENSE_EVENT_SAMPLES, 1);
+
+	unlink(BENCH_NOISE_FILE);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,403 @@
+/*
+ * Goertzel kernel microbenchmarks, cross-checked against the reference.
+ *
+ *   make kernel && bin/dtmf_kernel [SAMPLES]
+ *
+ * Every kernel that computes Goertzel strengths is run over the same signal
+ * (a DTMF tone in white noise, SAMPLES samples long, default 2^20) in blocks
+ * of each of a range of sizes N, for the eight DTMF frequencies and for a bank
+ * of ANALYZER_MAX_TONES frequencies.  The kernels are:
+ *
+ *   ref     ref_goertzel_step() and ref_goertzel_strength(), one filter at
+ *           a time, from tests/ref_goertzel.o
+ *   step    goertzel_step() and goertzel_strength(), in the same way
+ *   fixed   goertzel_fixed_step() and goertzel_fixed_strength()
+ *   bank    analyzer_feed(), all the filters at once
+ *   bank-q  analyzer_feed() with the fixed-point filters
+ *
+ * Each case is timed KERNEL_REPEAT times and the fastest run is reported,
+ * one tab-separated line per case:
+ *
+ *   kernel  tones  N  samples  cycles  ns  max_ulp  max_err  ok
+ *
+ * where cycles and ns are per sample per filter.  Cycles are time-stamp
+ * counter ticks, which on current x86 processors run at the nominal clock
+ * rate whatever the actual one; elsewhere the column repeats ns.
+ *
+ * Every strength is compared with the one that the reference computes for
+ * the same block.  max_ulp is the largest difference in units in the last
+ * place of the energy of the block (see kernel_ulps()), and max_err the
+ * largest absolute difference.  A kernel is accepted (ok is 1) if every
+ * strength is within its bound of ULPs of the reference or, for the kernels
+ * that do not compute in double precision, within KERNEL_REL_EPSILON of the
+ * block energy.  The filter states of goertzel_step() match
+ * those of the reference bit for bit, but the final iteration of either
+ * rounds a little differently, so the double-precision kernels are held to
+ * KERNEL_MAX_ULP rather than to bitwise agreement: a change to the kernels
+ * that loses precision shows up here well before it shows up as a missed
+ * tone.
+ *
+ * Finally the sample I/O of audio.c is compared with tests/ref_audio.o over
+ * all 65536 sample values, in rows of the same form, where tones is 1 and
+ * max_ulp counts the samples that differ.
+ *
+ * The exit status is nonzero if any check failed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "audio.h"
+#include "dtmf.h"
+#include "goertzel.h"
+#include "goertzel_fixed.h"
+#include "analyzer.h"
+
+#define KERNEL_REPEAT 5
+#define KERNEL_SAMPLES (1 << 20)
+
+/* Accepted error of the double-precision kernels, in ULPs of the block energy */
+#define KERNEL_MAX_ULP 64
+
+/*
+ * Accepted error of the kernels that do not compute in double precision, as a
+ * fraction of the block energy: the relative tolerance of the tests.
+ */
+#define KERNEL_REL_EPSILON 1e-3
+
+/* The reference objects have no header of their own */
+void ref_goertzel_init(GOERTZEL_STATE *gp, uint32_t N, double k);
+void ref_goertzel_step(GOERTZEL_STATE *gp, double x);
+double ref_goertzel_strength(GOERTZEL_STATE *gp, double x);
+int ref_audio_read_sample(FILE *in, int16_t *samplep);
+int ref_audio_write_sample(FILE *out, int16_t sample);
+
+static const int kernel_blocks[] = {10, 25, 50, 100, 205, 500, 1000, 4000};
+
+/*
+ * The signal, as big-endian bytes for the analyzer, as samples for the
+ * fixed-point filters, and divided by INT16_MAX for the others.
+ */
+typedef struct kernel_input {
+	size_t n;
+	uint8_t *pcm;
+	int16_t *samples;
+	double *x;
+} KERNEL_INPUT;
+
+/*
+ * A kernel stores the strengths of each block of N samples, block after
+ * block, ntones to a block.
+ */
+typedef void kernel_fn(const KERNEL_INPUT *in, uint32_t N, const double *freqs, int ntones,
+                       double *power);
+
+typedef struct kernel {
+	const char *name;
+	kernel_fn *run;
+	uint64_t max_ulp;   // Largest accepted difference from the reference, in ULPs
+	double rel;         // or else as a fraction, of the block energy.
+} KERNEL;
+
+static uint64_t kernel_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+static double kernel_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double kernel_k(double freq, uint32_t N) {
+	return freq * N / AUDIO_FRAME_RATE;
+}
+
+static void kernel_ref(const KERNEL_INPUT *in, uint32_t N, const double *freqs, int ntones,
+                       double *power) {
+	for (size_t base = 0; base + N <= in->n; base += N, power += ntones) {
+		for (int f = 0; f < ntones; f++) {
+			GOERTZEL_STATE g;
+			ref_goertzel_init(&g, N, kernel_k(freqs[f], N));
+			for (uint32_t i = 0; i < N - 1; i++) {
+				ref_goertzel_step(&g, in->x[base + i]);
+			}
+			power[f] = ref_goertzel_strength(&g, in->x[base + N - 1]);
+		}
+	}
+}
+
+static void kernel_step(const KERNEL_INPUT *in, uint32_t N, const double *freqs, int ntones,
+                        double *power) {
+	for (size_t base = 0; base + N <= in->n; base += N, power += ntones) {
+		for (int f = 0; f < ntones; f++) {
+			GOERTZEL_STATE g;
+			goertzel_init(&g, N, kernel_k(freqs[f], N));
+			for (uint32_t i = 0; i < N - 1; i++) {
+				goertzel_step(&g, in->x[base + i]);
+			}
+			power[f] = goertzel_strength(&g, in->x[base + N - 1]);
+		}
+	}
+}
+
+static void kernel_fixed(const KERNEL_INPUT *in, uint32_t N, const double *freqs, int ntones,
+                         double *power) {
+	for (size_t base = 0; base + N <= in->n; base += N, power += ntones) {
+		for (int f = 0; f < ntones; f++) {
+			GOERTZEL_FIXED_STATE q;
+			goertzel_fixed_init(&q, N, kernel_k(freqs[f], N));
+			for (uint32_t i = 0; i < N - 1; i++) {
+				goertzel_fixed_step(&q, in->samples[base + i]);
+			}
+			power[f] = goertzel_fixed_strength(&q, in->samples[base + N - 1]);
+		}
+	}
+}
+
+static void kernel_analyzer(const KERNEL_INPUT *in, uint32_t N, const double *freqs, int ntones,
+                            double *power, int fixed) {
+	TONE_ANALYZER analyzer;
+	const uint8_t *pcm = in->pcm;
+	size_t left = in->n;
+	analyzer_init(&analyzer, freqs, ntones, N, AUDIO_FRAME_RATE);
+	analyzer.fixed = fixed;
+	while (analyzer_feed(&analyzer, &pcm, &left, power)) {
+		power += ntones;
+	}
+}
+
+static void kernel_bank(const KERNEL_INPUT *in, uint32_t N, const double *freqs, int ntones,
+                        double *power) {
+	kernel_analyzer(in, N, freqs, ntones, power, 0);
+}
+
+static void kernel_bank_q(const KERNEL_INPUT *in, uint32_t N, const double *freqs, int ntones,
+                          double *power) {
+	kernel_analyzer(in, N, freqs, ntones, power, 1);
+}
+
+static const KERNEL kernels[] = {
+	{"ref", kernel_ref, 0, 0},
+	{"step", kernel_step, KERNEL_MAX_ULP, 0},
+	{"fixed", kernel_fixed, 0, KERNEL_REL_EPSILON},
+#ifdef ANALYZER_FLOAT
+	{"bank", kernel_bank, 0, KERNEL_REL_EPSILON},
+#else
+	{"bank", kernel_bank, KERNEL_MAX_ULP, 0},
+#endif
+	{"bank-q", kernel_bank_q, 0, KERNEL_REL_EPSILON},
+};
+
+/*
+ * Difference between a strength and the reference one, in units in the last
+ * place of the mean square of the samples of the block, which is the strength
+ * of a pure tone that fills the block.  The rounding errors of a Goertzel
+ * filter scale with the energy of the block, not with its own output, so the
+ * weak strengths of the filters that are not excited are measured on the same
+ * scale as the strong ones.
+ */
+static uint64_t kernel_ulps(double got, double expected, double energy) {
+	double ulp = nextafter(energy, INFINITY) - energy;
+	double err = fabs(got - expected);
+	if (energy == 0) {
+		return err == 0 ? 0 : UINT64_MAX;
+	}
+	return err / ulp > (double)UINT64_MAX ? UINT64_MAX : (uint64_t)ceil(err / ulp);
+}
+
+static void kernel_report(const char *name, int tones, uint32_t N, size_t samples,
+                          uint64_t ticks, double seconds, uint64_t max_ulp, double max_err, int ok) {
+	double per = (double)samples * tones;
+	printf("%s\t%d\t%u\t%zu\t%.3f\t%.3f\t%llu\t%.3g\t%d\n", name, tones, N, samples,
+	       ticks / per, seconds * 1e9 / per, (unsigned long long)max_ulp, max_err, ok);
+}
+
+/*
+ * Run every kernel for one set of frequencies and one block size, and
+ * return the number of kernels that disagree with the reference.
+ */
+static int kernel_case(const KERNEL_INPUT *in, const double *freqs, int ntones, uint32_t N) {
+	size_t blocks = in->n / N;
+	double *expected = malloc(blocks * ntones * sizeof(double));
+	double *power = malloc(blocks * ntones * sizeof(double));
+	if (expected == NULL || power == NULL) {
+		fprintf(stderr, "out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+	kernel_ref(in, N, freqs, ntones, expected);
+
+	int failed = 0;
+	for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+		const KERNEL *kp = kernels + k;
+		uint64_t best_ticks = UINT64_MAX;
+		double best_seconds = 1e30;
+		for (int r = 0; r < KERNEL_REPEAT; r++) {
+			double t = kernel_now();
+			uint64_t ticks = kernel_ticks();
+			kp->run(in, N, freqs, ntones, power);
+			ticks = kernel_ticks() - ticks;
+			t = kernel_now() - t;
+			best_ticks = ticks < best_ticks ? ticks : best_ticks;
+			best_seconds = t < best_seconds ? t : best_seconds;
+		}
+
+		uint64_t max_ulp = 0;
+		double max_err = 0, energy = 0;
+		int ok = 1;
+		for (size_t i = 0; i < blocks * ntones; i++) {
+			if (i % ntones == 0) {
+				const double *x = in->x + i / ntones * N;
+				energy = 0;
+				for (uint32_t j = 0; j < N; j++) {
+					energy += x[j] * x[j];
+				}
+				energy /= N;
+			}
+			uint64_t ulp = kernel_ulps(power[i], expected[i], energy);
+			double err = fabs(power[i] - expected[i]);
+			max_ulp = ulp > max_ulp ? ulp : max_ulp;
+			max_err = err > max_err ? err : max_err;
+			if (ulp > kp->max_ulp && err > kp->rel * energy) {
+				ok = 0;
+			}
+		}
+		kernel_report(kp->name, ntones, N, blocks * N, best_ticks, best_seconds,
+		              max_ulp, max_err, ok);
+		failed += !ok;
+	}
+	free(expected);
+	free(power);
+	return failed;
+}
+
+/*
+ * Write every sample value with both writers and read the bytes back with
+ * both readers, and return the number of checks that failed.
+ */
+static int kernel_audio(void) {
+	const size_t n = 1 << 16;
+	char *mine = NULL, *theirs = NULL;
+	size_t mine_size = 0, theirs_size = 0;
+	int failed = 0;
+
+	int (*writers[])(FILE *, int16_t) = {audio_write_sample, ref_audio_write_sample};
+	char **bufs[] = {&mine, &theirs};
+	size_t *sizes[] = {&mine_size, &theirs_size};
+	uint64_t ticks[2];
+	double seconds[2];
+	for (int w = 0; w < 2; w++) {
+		FILE *out = open_memstream(bufs[w], sizes[w]);
+		seconds[w] = kernel_now();
+		ticks[w] = kernel_ticks();
+		for (size_t i = 0; i < n; i++) {
+			writers[w](out, (int16_t)i);
+		}
+		ticks[w] = kernel_ticks() - ticks[w];
+		seconds[w] = kernel_now() - seconds[w];
+		fclose(out);
+	}
+	uint64_t differ = mine_size != theirs_size ? n : 0;
+	for (size_t i = 0; !differ && i < n; i++) {
+		differ += memcmp(mine + 2 * i, theirs + 2 * i, 2) != 0;
+	}
+	kernel_report("audio-write", 1, 0, n, ticks[0], seconds[0], differ, 0, differ == 0);
+	kernel_report("ref-write", 1, 0, n, ticks[1], seconds[1], 0, 0, 1);
+	failed += differ != 0;
+
+	int (*readers[])(FILE *, int16_t *) = {audio_read_sample, ref_audio_read_sample};
+	int16_t *values[2];
+	for (int r = 0; r < 2; r++) {
+		FILE *in = fmemopen(theirs, theirs_size, "r");
+		values[r] = calloc(n, sizeof(int16_t));
+		seconds[r] = kernel_now();
+		ticks[r] = kernel_ticks();
+		for (size_t i = 0; i < n; i++) {
+			readers[r](in, values[r] + i);
+		}
+		ticks[r] = kernel_ticks() - ticks[r];
+		seconds[r] = kernel_now() - seconds[r];
+		fclose(in);
+	}
+	differ = 0;
+	for (size_t i = 0; i < n; i++) {
+		differ += values[0][i] != values[1][i] || values[1][i] != (int16_t)i;
+	}
+	kernel_report("audio-read", 1, 0, n, ticks[0], seconds[0], differ, 0, differ == 0);
+	kernel_report("ref-read", 1, 0, n, ticks[1], seconds[1], 0, 0, 1);
+	failed += differ != 0;
+
+	free(values[0]);
+	free(values[1]);
+	free(mine);
+	free(theirs);
+	return failed;
+}
+
+int main(int argc, char **argv) {
+	long n = argc > 1 ? atol(argv[1]) : KERNEL_SAMPLES;
+	if (n < kernel_blocks[sizeof(kernel_blocks) / sizeof(kernel_blocks[0]) - 1]) {
+		fprintf(stderr, "usage: %s [SAMPLES]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// the symbol '5' at -10 dB in white noise at -20 dB
+	KERNEL_INPUT in = {n, malloc(2 * n), malloc(n * sizeof(int16_t)), malloc(n * sizeof(double))};
+	if (in.pcm == NULL || in.samples == NULL || in.x == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+	uint32_t seed = 1;
+	for (long i = 0; i < n; i++) {
+		seed = seed * 1103515245 + 12345;
+		double t = (double)i / AUDIO_FRAME_RATE;
+		double v = 0.16 * (sin(2 * M_PI * 770 * t) + sin(2 * M_PI * 1336 * t))
+		           + 0.1 * ((int16_t)(seed >> 16) / 32768.0);
+		int16_t sample = (int16_t)lrint(v * INT16_MAX);
+		in.samples[i] = sample;
+		in.pcm[2 * i] = (uint16_t)sample >> 8;
+		in.pcm[2 * i + 1] = sample & 0xff;
+		in.x[i] = ((double)sample) / INT16_MAX;
+	}
+
+	double dtmf[NUM_DTMF_FREQS], bank[ANALYZER_MAX_TONES];
+	for (int f = 0; f < NUM_DTMF_FREQS; f++) {
+		dtmf[f] = dtmf_freqs[f];
+	}
+	// evenly spaced across the telephone band
+	for (int f = 0; f < ANALYZER_MAX_TONES; f++) {
+		bank[f] = 300 + f * (3400.0 - 300) / (ANALYZER_MAX_TONES - 1);
+	}
+
+	int failed = 0;
+	printf("# kernel\ttones\tN\tsamples\tcycles\tns\tmax_ulp\tmax_err\tok\n");
+	for (size_t b = 0; b < sizeof(kernel_blocks) / sizeof(kernel_blocks[0]); b++) {
+		failed += kernel_case(&in, dtmf, NUM_DTMF_FREQS, kernel_blocks[b]);
+	}
+	for (size_t b = 0; b < sizeof(kernel_blocks) / sizeof(kernel_blocks[0]); b++) {
+		failed += kernel_case(&in, bank, ANALYZER_MAX_TONES, kernel_blocks[b]);
+	}
+	failed += kernel_audio();
+
+	free(in.pcm);
+	free(in.samples);
+	free(in.x);
+	if (failed) {
+		fflush(stdout);
+		fprintf(stderr, "%d kernels disagree with the reference\n", failed);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,68 @@
+#!/bin/sh
+#
+# Compare the events detected by two builds of dtmf, normally the double and
+# single-precision (-DANALYZER_FLOAT) filter banks, over the event files and
+# audio files in rsrc and tests/rsrc, with and without noise, at a range of
+# block sizes.  Prints one line for each difference and exits nonzero if
+# there were any.
+#
+# Usage: bench/precision.sh REFERENCE_BIN CANDIDATE_BIN
+#
+
+REF=$1
+CAND=$2
+if [ ! -x "$REF" ] || [ ! -x "$CAND" ]; then
+	echo "usage: $0 REFERENCE_BIN CANDIDATE_BIN" >&2
+	exit 2
+fi
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# five minutes of 8 kHz white noise, as an .au file
+printf '\056\163\156\144\000\000\000\030\000\111\076\000\000\000\000\003\000\000\037\100\000\000\000\001' > "$TMP/noise.au"
+# from a fixed seed, so that every run compares the same inputs
+LC_ALL=C awk 'BEGIN {
+	seed = 1
+	for (i = 0; i < 2400000; i++) {
+		seed = (seed * 69069 + 1) % 4294967296
+		printf "%c%c", int(seed / 16777216), int(seed / 65536) % 256
+	}
+}' >> "$TMP/noise.au"
+
+AUDIO=""
+for events in rsrc/*.txt tests/rsrc/*.txt; do
+	[ -f "$events" ] || continue
+	name=$(basename "$events" .txt)
+	# long enough for the last event, in milliseconds
+	msec=$(awk '$2 > max { max = $2 } END { print int(max / 8) + 1000 }' "$events")
+	"$REF" -g -t "$msec" < "$events" > "$TMP/$name.au" || exit 2
+	AUDIO="$AUDIO $TMP/$name.au"
+	for level in -10 0 5; do
+		"$REF" -g -t "$msec" -n "$TMP/noise.au" -r -l $level < "$events" \
+		    > "$TMP/$name.noise$level.au" || exit 2
+		AUDIO="$AUDIO $TMP/$name.noise$level.au"
+	done
+done
+for au in rsrc/*.au tests/rsrc/*.au; do
+	[ -f "$au" ] && AUDIO="$AUDIO $au"
+done
+
+status=0
+runs=0
+for au in $AUDIO; do
+	for block in 10 50 100 205 500 1000; do
+		for opts in "" "-a"; do
+			"$REF" -d -b $block $opts < "$au" > "$TMP/ref.txt" 2>/dev/null
+			"$CAND" -d -b $block $opts < "$au" > "$TMP/cand.txt" 2>/dev/null
+			runs=$((runs + 1))
+			if ! cmp -s "$TMP/ref.txt" "$TMP/cand.txt"; then
+				echo "DIFF $(basename "$au") -b $block $opts"
+				diff "$TMP/ref.txt" "$TMP/cand.txt" | head -6
+				status=1
+			fi
+		done
+	done
+done
+echo "$runs runs compared, $([ $status = 0 ] && echo "no" || echo "some") differences"
+exit $status
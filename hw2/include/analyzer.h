@@ -0,0 +1,117 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Generic Goertzel tone analyzer.
+ *
+ * An analyzer runs one Goertzel filter (see goertzel.h) for each of a set of
+ * arbitrary target frequencies over successive blocks of block_size samples,
+ * and produces for each block a vector holding the strength of every target
+ * frequency in that block.  It knows nothing about what the tones mean, so
+ * that DTMF, call-progress, fax or MF detectors can all be built on the same
+ * inner loop.
+ *
+ * The filter states are kept as a structure of arrays, one array element per
+ * tone, padded to a multiple of ANALYZER_LANES.  Each sample is applied to the
+ * floating-point filters ANALYZER_LANES at a time, by a loop of fixed length
+ * with no branch over arrays that cannot overlap, which gcc turns into SIMD
+ * instructions at -O2 (make vectorize fails if it does not).  The fixed-point
+ * filters need 64-bit products, and stay scalar.  Everything that the final
+ * iteration of goertzel_strength() computes from the frequency alone is
+ * computed once, when the analyzer is initialized.
+ *
+ * Alongside the filters, the analyzer sums the squares of the samples, so that
+ * the mean power of each block is available in ap->energy, on the same scale
+ * as the strengths, without another pass over the data.  For a pure tone the
+ * strength at its frequency approaches the energy of the block.
+ *
+ * The strengths are exactly those computed by goertzel_strength() (or by
+ * goertzel_fixed_strength(), for the fixed-point filters) for samples
+ * divided by INT16_MAX.
+ */
+#define ANALYZER_MAX_TONES 32
+#define ANALYZER_LANES 4
+
+/*
+ * Type of the state of the floating-point filters.  Building with
+ * -DANALYZER_FLOAT (make float) runs the recurrences in single precision,
+ * which fits twice as many filters in each SIMD instruction of the loop in
+ * analyzer_feed(): ANALYZER_LANES in one 16-byte vector rather than two.  In
+ * make kernel, the bank kernel of bin/dtmf_kernel_float typically takes half
+ * to two thirds of the time per filter that it takes in bin/dtmf_kernel.
+ * For blocks of up to a few hundred samples the strengths then differ from
+ * the double-precision ones only in the last few significant digits; the
+ * final iteration and the strengths are always computed in double precision.
+ */
+#ifdef ANALYZER_FLOAT
+typedef float analyzer_real;
+#else
+typedef double analyzer_real;
+#endif
+
+typedef struct tone_analyzer {
+    int ntones;             // Number of target frequencies.
+    int lanes;              // ntones, rounded up to a multiple of ANALYZER_LANES.
+    uint32_t N;             // Number of samples in each block.
+    int stride;             // Number of bytes from one sample to the next.
+    int fixed;              // Nonzero to run the fixed-point filters.
+    uint32_t fill;          // Number of samples of the current block seen so far.
+    double sum_sq;          // Sum of the squares of the samples seen so far.
+    int64_t sum_sq_fixed;   // Same as sum_sq, in Q15 squared, for the fixed-point filters.
+    double energy;          // Mean square of the samples of the last completed block.
+    analyzer_real B[ANALYZER_MAX_TONES];    // 2 cos(A) for each tone.
+    analyzer_real s1[ANALYZER_MAX_TONES];   // Filter state for each tone.
+    analyzer_real s2[ANALYZER_MAX_TONES];
+    int32_t Bq[ANALYZER_MAX_TONES];     // Same as B, s1 and s2, for the
+    int32_t q1[ANALYZER_MAX_TONES];     // fixed-point filters (see goertzel_fixed.h).
+    int32_t q2[ANALYZER_MAX_TONES];
+    double re_C[ANALYZER_MAX_TONES];    // Constants C and D of the final
+    double im_C[ANALYZER_MAX_TONES];    // iteration, for each tone.
+    double re_Cq[ANALYZER_MAX_TONES];   // cos(A), which is used instead of B / 2
+                                        // by the fixed-point filters.
+    double re_D[ANALYZER_MAX_TONES];
+    double im_D[ANALYZER_MAX_TONES];
+} TONE_ANALYZER;
+
+/*
+ * Initialize an analyzer.
+ *
+ *   @param ap  Analyzer to be initialized.
+ *   @param freqs  Target frequencies, in Hz.
+ *   @param ntones  Number of target frequencies, at most ANALYZER_MAX_TONES.
+ *   @param block_size  Number of samples in each block.
+ *   @param rate  Sample rate, in samples per second.
+ *   @return 0 on success, -1 if there are too many frequencies.
+ */
+int analyzer_init(TONE_ANALYZER *ap, const double *freqs, int ntones,
+                  uint32_t block_size, uint32_t rate);
+
+/*
+ * Discard the block in progress, so that the next sample starts a new block.
+ */
+void analyzer_reset(TONE_ANALYZER *ap);
+
+/*
+ * Feed big-endian 16-bit PCM samples, ap->stride bytes apart, to an analyzer
+ * until either a block is completed or the samples run out.  The pointer and
+ * count are advanced past the samples that were consumed, so that the
+ * analyzer can be called in a loop:
+ *
+ *   while (analyzer_feed(ap, &pcm, &nsamples, power)) {
+ *       ... use power ...
+ *   }
+ *
+ *   @param ap  Analyzer state.
+ *   @param pcmp  Pointer to a pointer to the next sample.
+ *   @param nsamplesp  Pointer to the number of samples available.
+ *   @param power  Array into which the ntones strengths are stored when
+ *   a block is completed.
+ *   @return 1 if a block was completed, 0 if all the samples were consumed
+ *   without completing one.
+ */
+int analyzer_feed(TONE_ANALYZER *ap, const uint8_t **pcmp, size_t *nsamplesp, double *power);
+
+#endif
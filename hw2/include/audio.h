@@ -33,15 +33,18 @@
  *     This corresponds to a number of bytes per sample of 2 (AUDIO_BYTES_PER_SAMPLE).
  *   The fifth field in the header specifies the "sample rate", which is the
  *     number of frames per second.
- *     For us, this will always be 8000 (AUDIO_FRAME_RATE).
+ *     Audio files that we create always use 8000 (AUDIO_FRAME_RATE); any
+ *     nonzero rate is accepted when reading.
  *   The sixth field in the header specifies the number of audio channels.
- *     For us, this will always be 1 (AUDIO_CHANNELS), indicating monaural audio.
+ *     Audio files that we create always have 1 (AUDIO_CHANNELS), indicating
+ *     monaural audio; when reading, up to AUDIO_MAX_CHANNELS are accepted.
  */
 
 #define AUDIO_MAGIC (0x2e736e64)
 #define PCM16_ENCODING (3)
 #define AUDIO_FRAME_RATE 8000
 #define AUDIO_CHANNELS 1
+#define AUDIO_MAX_CHANNELS 8
 #define AUDIO_BYTES_PER_SAMPLE 2
 #define AUDIO_DATA_OFFSET 24
 
@@ -72,15 +75,15 @@ typedef struct audio_header {
  * then the number of bytes in a frame will be 2 * 2 = 4.  If the sample encoding is
  * 32-bit PCM (i.e. four bytes per sample) and the number of channels is two,
  * then the number of bytes in a frame will be 2 * 4 = 8.
- * For us, the number of bytes per frame will always be AUDIO_CHANNELS * AUDIO_BYTES_PER_SAMPLE;
- * that is, 2.
+ * For us, the number of bytes per frame will be channels * AUDIO_BYTES_PER_SAMPLE;
+ * that is, 2 for the monaural audio we create.
  *
  * Within a frame, the sample data for each channel occurs in sequence.
  * For example, in case of 16-bit PCM encoded stereo, the first two bytes of each
  * frame represents a single sample for channel 0 and the second two bytes
  * represents a single sample for channel 1.  Samples are signed values encoded
  * in two's-complement and are presented in big-endian (most significant byte first)
- * byte order.  For us, there will be just one two-byte sample per frame.
+ * byte order.
  */
 
 /*
@@ -107,7 +110,8 @@ typedef struct audio_header {
  * are stored into the AUDIO_HEADER structure pointed at by hp.
  * The header is then checked for validity, which means:  no error occurred
  * while reading the header data, the magic number is valid, the value of encoding
- * field is PCM16_ENCODING, and the value of the channels field is AUDIO_CHANNELS.
+ * field is PCM16_ENCODING, the sample rate is nonzero, and the value of the
+ * channels field is between 1 and AUDIO_MAX_CHANNELS.
  * Once the header is read and validated, any annotation data that may be present
  * is skipped, so that when this function returns the input pointer is pointing
  * at the the start of the audio sample data.
@@ -138,6 +142,19 @@ int audio_write_header(FILE *out, AUDIO_HEADER *hp);
  */
 int audio_read_sample(FILE *in, int16_t *samplep);
 
+/**
+ * Read a sequence of two-byte audio samples from an input stream.
+ * The data is read in large chunks and converted from big-endian byte order
+ * in bulk, rather than a sample at a time.
+ *
+ *   @param in  Input stream from which samples are to be read.
+ *   @param samples  Array into which the samples are to be stored.
+ *   @param n  Maximum number of samples to be read.
+ *   @return The number of samples read, which is less than n only at EOF
+ *   or on error.
+ */
+size_t audio_read_samples(FILE *in, int16_t *samples, size_t n);
+
 /**
  * Write a single two-byte audio sample to an output stream.
  *
@@ -147,4 +164,22 @@ int audio_read_sample(FILE *in, int16_t *samplep);
  */
 int audio_write_sample(FILE *out, int16_t sample);
 
+/**
+ * Write a sequence of two-byte audio samples to an output stream.
+ * The samples are converted to big-endian byte order in bulk and written
+ * in large chunks, rather than a sample at a time.
+ *
+ *   @param out  Output stream to which samples are to be written.
+ *   @param samples  Samples to be written.
+ *   @param n  Number of samples to be written.
+ *   @return 0 on success, EOF otherwise.
+ */
+int audio_write_samples(FILE *out, const int16_t *samples, size_t n);
+
+/*
+ * Number of samples converted and read or written at a time by
+ * audio_read_samples() and audio_write_samples().
+ */
+#define AUDIO_WRITE_CHUNK 8192
+
 #endif
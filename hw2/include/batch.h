@@ -0,0 +1,36 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+/*
+ * Maximum number of worker threads for batch detection.
+ */
+#define BATCH_MAX_THREADS 64
+
+/*
+ * Batch DTMF detection.
+ * The audio files to be analyzed are named by list, which is either a
+ * directory, in which case every regular file in it (other than hidden ones)
+ * is analyzed, or a text file containing one pathname per line.
+ *
+ * The files are shared out among a pool of worker threads, each of which has
+ * its own detectors and filter banks.  A worker only initializes its detectors
+ * again when a file has a different sample rate or number of channels from the
+ * previous one, so the setup cost is paid once per thread rather than once per
+ * file.  Each event is printed, in the usual format, after the pathname of the
+ * file and a tab.  All the events of one file are printed together, but the
+ * files appear in the order in which they were finished.
+ *
+ * A file that cannot be opened or is not valid audio is reported on stderr
+ * and skipped.
+ *
+ *   @param list  Directory or file list naming the files to be analyzed.
+ *   @param threads  Number of worker threads, or 0 for one per online CPU.
+ *   @param events_out  Stream to which events are to be written.
+ *   @return 0 if every file was analyzed and its events written successfully,
+ *   EOF otherwise.
+ */
+int dtmf_detect_batch(const char *list, int threads, FILE *events_out);
+
+#endif
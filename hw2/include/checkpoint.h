@@ -0,0 +1,74 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "detector.h"
+
+/*
+ * Checkpoints of the detector.
+ *
+ * A checkpoint holds everything that a set of detectors (one per channel)
+ * remembers about the audio seen so far: the filter states of the block in
+ * progress, the event in progress and its peak strengths, the number of
+ * samples consumed, and the summary counts.  Restoring it into detectors set
+ * up the same way puts them in exactly the state they were in, so that a scan
+ * of a long capture can be stopped and resumed, or a capture split at a
+ * checkpoint can be scanned in pieces, with the same events as a single scan.
+ *
+ * Checkpoints are written in native byte order and are only meant to be
+ * read by the same build of the program.  The header records the
+ * configuration of the detectors, which must match when restoring.
+ */
+#define CHECKPOINT_MAGIC 0x646b7074     // "dkpt"
+#define CHECKPOINT_VERSION 1
+
+/*
+ * Interval, in seconds of audio, between the checkpoints written by
+ * detector_run_checkpointed().
+ */
+#define CHECKPOINT_SECONDS 60
+
+/*
+ * Write a checkpoint of a set of detectors.
+ *
+ *   @param dps  Array of detectors, one for each channel, in channel order.
+ *   @param channels  Number of channels.
+ *   @param out  Stream to which the checkpoint is to be written.
+ *   @return 0 on success, EOF if the checkpoint could not be written.
+ */
+int detector_checkpoint(const DTMF_DETECTOR *dps, int channels, FILE *out);
+
+/*
+ * Restore a set of detectors from a checkpoint.  The detectors must already
+ * have been initialized and configured as those that were checkpointed.
+ *
+ *   @param dps  Array of detectors, one for each channel, in channel order.
+ *   @param channels  Number of channels.
+ *   @param in  Stream from which the checkpoint is to be read.
+ *   @return 0 on success, EOF if the checkpoint could not be read or was
+ *   made by detectors with a different configuration, in which case the
+ *   detectors are unchanged.
+ */
+int detector_restore(DTMF_DETECTOR *dps, int channels, FILE *in);
+
+/*
+ * Same as detector_run_file(), but resumable.  If the file named by path
+ * holds a checkpoint, the detectors are restored from it and the frames that
+ * it covers are skipped in the input.  Every CHECKPOINT_SECONDS of audio the
+ * events found so far are flushed and a new checkpoint replaces the file.
+ * When the whole input has been analyzed the file is removed.
+ *
+ * Events found after the last checkpoint of an interrupted run are reported
+ * again by the run that resumes it.
+ *
+ *   @param dps  Array of detectors, one for each channel, in channel order.
+ *   @param channels  Number of channels.
+ *   @param in  Stream positioned at the start of the sample data.
+ *   @param path  Name of the checkpoint file.
+ *   @return 0 if all events were written successfully, EOF otherwise.
+ */
+int detector_run_checkpointed(DTMF_DETECTOR *dps, int channels, FILE *in, const char *path);
+
+#endif
@@ -14,7 +14,7 @@
 
 #define USAGE(program_name, retcode) do { \
 fprintf(stderr, "USAGE: %s %s\n", program_name, \
-"[-h] -g|-d [-t MSEC] [-n NOISE_FILE] [-l LEVEL] [-b BLOCKSIZE]\n" \
+"[-h] -g|-d [-t MSEC] [-n NOISE_FILE] [-l LEVEL] [-r] [-j THREADS] [-b BLOCKSIZE] [-s] [-q] [-a] [-B LIST [-j THREADS]] [-T TRACE_FILE] [-O FORMAT] [-C CHECKPOINT_FILE]\n" \
 "   -h       Help: displays this help menu.\n" \
 "   -g       Generate: read DTMF events from standard input, output audio data to standard output.\n" \
 "   -d       Detect: read audio data from standard input, output DTMF events to standard output.\n\n" \
@@ -26,10 +26,33 @@ fprintf(stderr, "USAGE: %s %s\n", program_name, \
 "                               noise to that of the DTMF tones.  A LEVEL of 0 (the default) means the\n" \
 "                               same level, negative values mean that the DTMF tones are louder than\n" \
 "                               the noise, positive values mean that the noise is louder than the\n" \
-"                               DTMF tones.\n\n" \
-"            Optional additional parameter for -d (not permitted with -g):\n" \
+"                               DTMF tones.\n" \
+"               -r              Repeat the noise from the beginning if it is shorter than the output,\n" \
+"                                instead of continuing with silence.\n" \
+"               -j THREADS      Generate with THREADS threads (range [1, 64], default 1).  Only has an\n" \
+"                                effect when standard output is a regular file; the output is the same.\n\n" \
+"            Optional additional parameters for -d (not permitted with -g):\n" \
 "               -b BLOCKSIZE    specifies the number of samples (range [10, 1000], default 100)\n" \
 "                                in each block of audio to be analyzed for the presence of DTMF tones.\n" \
+"               -s              Streaming: report \"tone-start\" as soon as a tone has lasted long enough\n" \
+"                                to be an event and \"tone-end\" when it stops, flushing after each line.\n" \
+"               -q              Run the fixed-point (Q15 samples, Q2.30 coefficients) Goertzel filters\n" \
+"                                instead of the double-precision ones.\n" \
+"               -a              Adaptive threshold: require the DTMF tones to carry at least a quarter\n" \
+"                                of the power of each block, instead of a fixed minimum strength.\n" \
+"               -B LIST         Batch: analyze every audio file in the directory LIST, or named in the\n" \
+"                                file LIST (one per line), instead of standard input, prefixing each\n" \
+"                                event with the name of its file.  Not permitted with -s.\n" \
+"               -j THREADS      Number of threads (range [1, 64], default one per CPU) for -B.\n" \
+"               -T TRACE_FILE   Write a binary record of the strengths and decision for each block\n" \
+"                                to TRACE_FILE (see stats.h).  Not permitted with -B.\n" \
+"               -O FORMAT       Output format: text (the default), binary (a fixed-size record for each\n" \
+"                                event, see detector.h; not permitted with -B), or summary (one line\n" \
+"                                per symbol: count, total, shortest and longest length in samples).\n" \
+"                                binary and summary are not permitted with -s.\n" \
+"               -C CHECKPOINT_FILE  Resume from CHECKPOINT_FILE if it exists, skipping the audio it\n" \
+"                                covers, and save a checkpoint there every minute of audio; it is\n" \
+"                                removed when the input has been analyzed.  Not permitted with -B.\n" \
 ); \
 exit(retcode); \
 } while(0)
@@ -38,12 +61,22 @@ exit(retcode); \
 #define HELP_OPTION (0x1)
 #define GENERATE_OPTION (0x2)
 #define DETECT_OPTION (0x4)
+#define STREAM_OPTION (0x8)
+#define FIXED_OPTION (0x10)
+#define LOOP_OPTION (0x20)
+#define ADAPTIVE_OPTION (0x40)
 
 int global_options;  // Bitmap specifying mode of program operation.
 char *noise_file;    // Name of noise file, or NULL if none.
 int noise_level;     // Ratio (in dB) of noise level to DTMF tone level.
 int block_size;      // Block size used in DTMF tone detection.
 int audio_samples;   // Number of samples in generated audio file.
+char *batch_list;    // Directory or file list for batch detection, or NULL if none.
+int batch_threads;   // Number of threads for batch detection, or 0 for one per CPU.
+char *trace_file;    // File to which to write a per-block detection trace, or NULL if none.
+int generate_threads; // Number of threads for generation, or 0 for one.
+int output_format;   // Form of the detection output (DETECT_FORMAT_ in detector.h).
+char *checkpoint_file; // File holding the checkpoint of the detection, or NULL if none.
 
 /*
  * Some fixed parameters that we use for this program.
@@ -0,0 +1,282 @@
+#ifndef DETECTOR_H
+#define DETECTOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "audio.h"
+#include "dtmf.h"
+#include "analyzer.h"
+#include "stats.h"
+#include "source.h"
+#include "summary.h"
+
+/*
+ * Minimum length (in samples) of a DTMF event that is reported.
+ * This is MIN_DTMF_DURATION at AUDIO_FRAME_RATE, rounded up to the value
+ * the detector has always used.
+ */
+#define MIN_EVENT_SAMPLES 250
+
+/*
+ * Number of samples requested from the input stream per read when the
+ * detector is not streaming.  In streaming mode one block is read at a time,
+ * so that each block is analyzed as soon as it has arrived.
+ */
+#define DETECT_READ_SAMPLES 4096
+
+/*
+ * In adaptive mode, a block passes the floor test if the strongest row and
+ * column together carry at least ADAPTIVE_RATIO (-6 dB) of the mean power of
+ * the block, rather than a fixed .01, so that the test follows the level of
+ * the line: tones well below the fixed floor are still found, and tones that
+ * are partly masked by noise are accepted as long as the other tests pass.
+ * Blocks whose power is below ADAPTIVE_MIN_ENERGY (-60 dB) are taken to be
+ * silence.
+ */
+#define ADAPTIVE_RATIO 0.25
+#define ADAPTIVE_MIN_ENERGY 1e-6
+
+/*
+ * Forms in which a detector reports events.
+ */
+#define DETECT_FORMAT_TEXT 0      // Lines of text, as described for dtmf_detect().
+#define DETECT_FORMAT_BINARY 1    // A DETECTOR_EVENT_RECORD for each event.
+#define DETECT_FORMAT_SUMMARY 2   // Nothing; the events are only counted in the summary.
+
+/*
+ * Record written for each event in binary format (-O binary), in native
+ * byte order, so that the events can be processed without parsing text.
+ * The peak strengths are the greatest strengths of the row and column
+ * frequencies of the symbol in any block of the event.  The sample indices
+ * are 64 bits wide, like the detector's own, so that they do not wrap in long
+ * streams.  Each record is 32 bytes, with no padding other than pad:
+ *
+ *   offset  0  start     offset 20  col_peak
+ *   offset  8  end       offset 24  channel
+ *   offset 16  row_peak  offset 26  symbol
+ */
+typedef struct detector_event_record {
+    uint64_t start;         // Index of the first sample of the event.
+    uint64_t end;           // Index just past the last sample of the event.
+    float row_peak;         // Peak strength of the row frequency.
+    float col_peak;         // Peak strength of the column frequency.
+    uint16_t channel;       // Channel number (0 for monaural audio).
+    uint8_t symbol;         // DTMF symbol.
+    uint8_t pad[5];
+} DETECTOR_EVENT_RECORD;
+
+/*
+ * State of one instance of the DTMF detector.
+ * Samples are fed to the detector in arbitrary-sized pieces; the detector
+ * uses a tone analyzer to obtain the strengths of the DTMF frequencies in
+ * each block of block_size samples and keeps track of the DTMF event in
+ * progress.  Setting analyzer.fixed selects the fixed-point filters.
+ */
+typedef struct dtmf_detector {
+    int block_size;         // Number of samples in each analyzed block.
+    uint32_t rate;          // Sample rate of the audio, in frames per second.
+    int min_event;          // MIN_EVENT_SAMPLES, scaled to the sample rate.
+    int channel;            // Channel number printed with each event, or -1 for none.
+    const char *tag;        // String printed before each event, or NULL for none.
+    TONE_ANALYZER analyzer; // Filter bank for the eight DTMF frequencies.
+    double *strengths;      // Strengths computed at the end of the last block.
+    double own_strengths[NUM_DTMF_FREQS];  // Storage for strengths, if none was supplied.
+    int64_t starting_block; // Sample index at which the event in progress started.
+    int64_t current_block;  // Number of samples consumed so far.
+    char previous_event;    // Symbol of the event in progress, or 0 if none.
+    int streaming;          // Nonzero to report tone-start/tone-end as they happen.
+    int adaptive;           // Nonzero to scale the floor to the energy of each block.
+    int started;            // Nonzero if tone-start has been reported for the event in progress.
+    FILE *out;              // Stream to which events are written.
+    FILE *trace;            // Stream to which a record is written for each block, or NULL.
+    int format;             // One of the DETECT_FORMAT_ values.
+    double peak[2];         // Peak row and column strengths of the event in progress.
+    DETECTOR_SUMMARY summary;  // Events counted in summary format.
+    DETECTOR_STATS stats;   // Counts kept when built with -DSTATS.
+} DTMF_DETECTOR;
+
+/*
+ * Initialize a detector for monaural audio.  A detector for one channel of
+ * interleaved audio is obtained by then setting analyzer.stride to the size
+ * of a frame and channel to the channel number.
+ *
+ *   @param dp  Detector to be initialized.
+ *   @param block_size  Number of samples in each block.
+ *   @param rate  Sample rate of the audio, in frames per second.
+ *   @param strengths  Storage for NUM_DTMF_FREQS strength values,
+ *   or NULL to use storage within the detector.
+ *   @param out  Stream to which events are to be written.
+ */
+void detector_init(DTMF_DETECTOR *dp, int block_size, uint32_t rate,
+                   double *strengths, FILE *out);
+
+/*
+ * Initialize one detector for each channel of audio in the format given by
+ * an audio header, with storage for the strengths within the detectors.
+ *
+ *   @param dps  Array of at least hp->channels detectors.
+ *   @param hp  Header of the audio to be analyzed.
+ *   @param block_size  Number of samples in each block.
+ *   @param out  Stream to which events are to be written.
+ *   @return 0 on success, EOF if the sample rate is too low for the
+ *   DTMF frequencies to be detected.
+ */
+int detector_init_channels(DTMF_DETECTOR *dps, AUDIO_HEADER *hp, int block_size, FILE *out);
+
+/*
+ * Prepare a detector to analyze a new stream of audio in the same format as
+ * before, keeping its configuration but forgetting any event in progress.
+ * This is much cheaper than initializing the detector again.
+ *
+ *   @param dp  Detector to be reset.
+ *   @param out  Stream to which events are to be written.
+ */
+void detector_reset(DTMF_DETECTOR *dp, FILE *out);
+
+/*
+ * Feed big-endian 16-bit PCM samples, exactly as they appear in the payload
+ * of an .au file, to a detector.  Successive samples are dp->analyzer.stride
+ * bytes apart.  Any events that are completed by these samples are written to the
+ * output stream.
+ *
+ *   @param dp  Detector state.
+ *   @param pcm  Pointer to the first byte of sample data.
+ *   @param nsamples  Number of samples (not bytes) available at pcm.
+ */
+void detector_feed(DTMF_DETECTOR *dp, const uint8_t *pcm, size_t nsamples);
+
+/*
+ * Signal the end of the input, emitting the event in progress (if any).
+ *
+ *   @param dp  Detector state.
+ *   @return 0 if all events were written successfully, EOF otherwise.
+ */
+int detector_finish(DTMF_DETECTOR *dp);
+
+/*
+ * Read sample data from a stream until EOF, feeding it to a detector,
+ * and then finish the detector.  The stream must be positioned at the
+ * start of the sample data.
+ *
+ *   @return 0 if all events were written successfully, EOF otherwise.
+ */
+int detector_run(DTMF_DETECTOR *dp, FILE *in);
+
+/*
+ * Same as detector_run(), but for audio with several interleaved channels,
+ * each of which has its own detector.  The data is read a chunk of frames at
+ * a time and each chunk is fed to the detectors in turn, so the events of
+ * different channels are interleaved only roughly in order of time.
+ *
+ *   @param dps  Array of detectors, one for each channel, in channel order.
+ *   @param channels  Number of channels.
+ *   @param in  Stream positioned at the start of the sample data.
+ *   @return 0 if all events were written successfully, EOF otherwise.
+ */
+int detector_run_channels(DTMF_DETECTOR *dps, int channels, FILE *in);
+
+/*
+ * Same as detector_run_channels(), but reading the data through the best
+ * sample source for the stream (see source_open()): a regular file is mapped
+ * into memory and the samples are fed to the detectors directly from the
+ * mapping, and a pipe is read one chunk ahead on a second thread.
+ * The position of the stream is not advanced when the file is mapped.
+ *
+ *   @param dps  Array of detectors, one for each channel, in channel order.
+ *   @param channels  Number of channels.
+ *   @param in  Stream positioned at the start of the sample data.
+ *   @return 0 if all events were written successfully, EOF otherwise.
+ */
+int detector_run_file(DTMF_DETECTOR *dps, int channels, FILE *in);
+
+/*
+ * Number of frames that detector_run_file() and detector_run_channels() take
+ * from the input at a time.
+ *
+ *   @param dps  Array of detectors, one for each channel, in channel order.
+ *   @param channels  Number of channels.
+ */
+size_t detector_chunk_frames(const DTMF_DETECTOR *dps, int channels);
+
+/*
+ * Same as detector_run_channels(), but taking the sample data from a source
+ * of frames of channels samples, instead of a stream.  The chunk size of the
+ * source determines how often the detectors take turns, so the events of
+ * different channels come out in the same order from every source with the
+ * same chunk size.
+ *
+ *   @param dps  Array of detectors, one for each channel, in channel order.
+ *   @param channels  Number of channels.
+ *   @param src  Source of the sample data.
+ *   @return 0 if all events were written successfully, EOF otherwise.
+ */
+int detector_run_source(DTMF_DETECTOR *dps, int channels, SAMPLE_SOURCE *src);
+
+/*
+ * Function called by detector_run_source_with() after each full chunk.
+ *
+ *   @param dps  Array of detectors, one for each channel, in channel order.
+ *   @param channels  Number of channels.
+ *   @param arg  The argument given to detector_run_source_with().
+ *   @return 0 to carry on, EOF to stop the run with an error.
+ */
+typedef int (*DETECTOR_CHUNK_HOOK)(DTMF_DETECTOR *dps, int channels, void *arg);
+
+/*
+ * Same as detector_run_source(), but calling hook, if not NULL, after every
+ * full chunk has been fed to the detectors.  If the hook returns EOF, no
+ * more input is read, the events in progress are still reported, and EOF is
+ * returned.
+ */
+int detector_run_source_with(DTMF_DETECTOR *dps, int channels, SAMPLE_SOURCE *src,
+                             DETECTOR_CHUNK_HOOK hook, void *arg);
+
+/*
+ * Determine which DTMF symbol, if any, is present given the strengths of the
+ * eight DTMF frequencies in a block.
+ *
+ *   @param strengths  NUM_DTMF_FREQS strength values, rows first.
+ *   @return  The DTMF symbol, or 0 if the block does not pass the tests.
+ */
+char detector_classify(const double *strengths);
+
+/*
+ * Same as detector_classify(), but also reporting which test, if any, the
+ * block failed.
+ *
+ *   @param strengths  NUM_DTMF_FREQS strength values, rows first.
+ *   @param outcome  Variable into which DETECT_ACCEPT or the DETECT_REJECT_
+ *   value for the failed test is stored.
+ *   @return  The DTMF symbol, or 0 if the block does not pass the tests.
+ */
+char detector_classify_outcome(const double *strengths, int *outcome);
+
+/*
+ * Same as detector_classify_outcome(), but with the given floor for the
+ * strength of the strongest row and column together instead of .01.
+ *
+ *   @param strengths  NUM_DTMF_FREQS strength values, rows first.
+ *   @param floor  Minimum strength of the strongest row plus the strongest column.
+ *   @param outcome  Variable into which the outcome is stored.
+ *   @return  The DTMF symbol, or 0 if the block does not pass the tests.
+ */
+char detector_classify_floor(const double *strengths, double floor, int *outcome);
+
+/*
+ * Floor used in adaptive mode for a block with the given mean power
+ * (see ADAPTIVE_RATIO).
+ */
+double detector_adaptive_floor(double energy);
+
+/*
+ * Maximum number of samples, measured from the onset of a tone, that can
+ * elapse before a streaming detector reports tone-start for it.
+ * A tone may begin just after a block boundary, in which case that block
+ * is lost; the tone is then reported at the end of the first block at which
+ * it has lasted dp->min_event samples.  tone-end is reported at most
+ * block_size samples after the tone stops.
+ */
+int detector_max_latency(const DTMF_DETECTOR *dp);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * A DTMF event, as read from the input to the generator.
+ */
+typedef struct dtmf_event {
+    uint32_t start;     // Index of the first sample of the event.
+    uint32_t end;       // Index just past the last sample of the event.
+    char symbol;        // DTMF symbol.
+    int row;            // Index in dtmf_freqs of the row frequency of the symbol.
+    int col;            // Index in dtmf_freqs of the column frequency of the symbol.
+} DTMF_EVENT;
+
+/*
+ * Read the next DTMF event, in the textual "start\tend\tsymbol\n" format,
+ * from a stream.  Each event is read as a whole line into line_buf and
+ * parsed from there.  The newline may be omitted from the last line.
+ *
+ * The event is checked to be well-formed and to fit the audio being generated:
+ * it must be nonempty, must not start before prev_end (so that the events are
+ * non-overlapping and in increasing order), and must end no later than length.
+ *
+ *   @param in  Stream from which to read the event.
+ *   @param ev  Structure into which the event is stored.
+ *   @param prev_end  End index of the previous event, or 0 for the first one.
+ *   @param length  Number of samples in the audio being generated.
+ *   @return 1 if an event was read, 0 if the stream is at EOF, and EOF if
+ *   the input is malformed or the event is out of order or out of range.
+ */
+int events_read(FILE *in, DTMF_EVENT *ev, uint32_t prev_end, uint32_t length);
+
+#endif
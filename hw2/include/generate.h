@@ -0,0 +1,52 @@
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Maximum number of worker threads for parallel generation.
+ */
+#define GENERATE_MAX_THREADS 64
+
+/*
+ * Number of samples in each range handed to a worker by parallel generation.
+ */
+#define GENERATE_SEGMENT_SAMPLES (1 << 16)
+
+/*
+ * Value returned by generate_parallel() when the streams do not allow the
+ * output to be generated in parallel.
+ */
+#define GENERATE_SERIAL 1
+
+/*
+ * Parallel DTMF generation.
+ * Every sample of the output depends only on its index, the event in which it
+ * lies and the noise sample at the same index, so the output can be produced
+ * in any order.  The events are read in full first; then the samples are
+ * split into ranges of GENERATE_SEGMENT_SAMPLES, which a pool of worker
+ * threads synthesize, mix with noise read by pread(), and write with pwrite()
+ * at their own offsets in the output.  The result is byte-for-byte the same
+ * as that of the serial generator.
+ *
+ * This is only possible if the output is a regular file that is not open for
+ * appending and the noise, if any, is a regular file.  Otherwise nothing is
+ * read or written and GENERATE_SERIAL is returned.
+ *
+ *   @param events_in  Stream from which to read DTMF events.
+ *   @param audio_out  Stream to which the header has just been written.
+ *   @param length  Number of audio samples to be written.
+ *   @param noise  Noise file positioned at the start of its sample data,
+ *   or NULL for none.
+ *   @param noise_loop  Nonzero to repeat the noise if it is shorter than
+ *   the output, instead of continuing with silence.
+ *   @param w  Weight of the noise, as for synth_mix().
+ *   @param threads  Number of worker threads.
+ *   @return 0 if the samples were written successfully, EOF on error, or
+ *   GENERATE_SERIAL.
+ */
+int generate_parallel(FILE *events_in, FILE *audio_out, uint32_t length,
+                      FILE *noise, int noise_loop, double w, int threads);
+
+#endif
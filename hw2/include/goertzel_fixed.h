@@ -0,0 +1,76 @@
+#ifndef GOERTZEL_FIXED_H
+#define GOERTZEL_FIXED_H
+
+#include <stdint.h>
+
+/*
+ * Fixed-point variant of the Goertzel algorithm in goertzel.h.
+ *
+ * Samples are taken exactly as they appear in the audio data, as Q15 values
+ * (that is, the integer x represents x / 2^15, which is within rounding of the
+ * x / INT16_MAX used by the double-precision version).  The multiplicative
+ * constant B = 2 cos(A) lies in [-2, 2) and is stored in Q2.30 format; for A
+ * so close to 0 (k = 0, or a sample rate far above the frequency) that it
+ * would round to 2, it is clamped to the largest Q2.30 value, 2 - 2^-30.
+ * The filter state variables are 32-bit integers on the same scale as the
+ * samples; the product B * s1 is formed in 64 bits and rounded back to that
+ * scale, so that each iteration is just an integer multiply, shift and add.
+ *
+ * The state variables grow by at most a factor of about min(N / sin(A), N^2)
+ * over the input, so they stay inside 32 bits as long as that factor is below
+ * 2^16.  For the DTMF frequencies and the block sizes accepted by the program
+ * (N <= 1000), this holds at sample rates up to about 280 kHz; at higher
+ * rates the fixed-point filters (-q) need a proportionally smaller block.
+ *
+ * Only the recurrence runs in fixed point.  The final strength computation,
+ * which happens once per block, converts the state to double and proceeds
+ * exactly as goertzel_strength() does.
+ */
+#define GOERTZEL_FIXED_COEF_BITS 30
+
+typedef struct goertzel_fixed_state {
+    uint32_t N;      // Number of samples in the signal to be analyzed.
+    double k;        // Real-valued "index" of the frequency component.
+    double A;        // Intermediate value used to compute B and C.
+    int32_t B;       // 2 * cos(A), in Q2.30 format.
+    int32_t s0;      // Goertzel filter state variables, same scale as the samples.
+    int32_t s1;
+    int32_t s2;
+} GOERTZEL_FIXED_STATE;
+
+/*
+ * One iteration of the recurrence: s0 = x + B * s1 - s2, with B * s1 rounded
+ * to the nearest integer on the scale of the samples.  Shared by the
+ * single-filter version and the filter bank of analyzer.c, so that both
+ * round in exactly the same way.
+ */
+static inline int32_t goertzel_fixed_recur(int32_t B, int32_t s1, int32_t s2, int32_t x) {
+    return x + (int32_t)(((int64_t)B * s1 + (1LL << (GOERTZEL_FIXED_COEF_BITS - 1)))
+                         >> GOERTZEL_FIXED_COEF_BITS) - s2;
+}
+
+/*
+ * Initialize the state of an instance of the fixed-point Goertzel algorithm.
+ * The parameters have the same meaning as for goertzel_init().
+ */
+void goertzel_fixed_init(GOERTZEL_FIXED_STATE *gp, uint32_t N, double k);
+
+/*
+ * Perform one iteration of the main loop of the fixed-point Goertzel algorithm.
+ *   @param gp  Pointer to structure containing the algorithm state.
+ *   @param x  The (raw 16-bit) sample of the signal at the current iteration.
+ */
+void goertzel_fixed_step(GOERTZEL_FIXED_STATE *gp, int16_t x);
+
+/*
+ * Perform the final iteration of the fixed-point Goertzel algorithm,
+ * returning the strength of the frequency component being analyzed,
+ * on the same scale as goertzel_strength() applied to samples divided by
+ * INT16_MAX.
+ *
+ *   @param gp  Pointer to structure containing the algorithm state.
+ *   @param x  The last (raw 16-bit) sample of the signal.
+ */
+double goertzel_fixed_strength(GOERTZEL_FIXED_STATE *gp, int16_t x);
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Sample sources.
+ *
+ * A sample source delivers the payload of an audio file (the frames that
+ * follow the header) a chunk at a time, so that the detector can run over
+ * audio wherever it comes from.  Each call to source_read() makes up to
+ * chunk frames available in memory owned by the source, and returns fewer
+ * only at the end of the audio; the data stays valid until the next call.
+ *
+ * The built-in sources are:
+ *   - stream: reads the data from a stdio stream into a buffer.
+ *   - mapped: maps a regular file into memory and returns pointers into
+ *     the mapping, so that the data is never copied.
+ *   - memory: returns pointers into audio already in memory.
+ *   - read-ahead: reads a stream on a second thread into one buffer while
+ *     the caller works on the other, so that waiting for a pipe overlaps
+ *     with running the filters.
+ * Other sources, such as a decoder for compressed audio, are made by
+ * filling in the read and close functions and the data pointer.
+ */
+typedef struct sample_source {
+    // Make up to chunk frames available at *pcmp and return how many.
+    size_t (*read)(struct sample_source *sp, const uint8_t **pcmp);
+    // Release the resources of the source.
+    void (*close)(struct sample_source *sp);
+    size_t frame;           // Number of bytes in each frame.
+    size_t chunk;           // Maximum number of frames returned by each read.
+    int error;              // Nonzero if an error occurred while reading.
+    int ended;              // Nonzero once the end of the audio has been reached.
+    FILE *in;               // Stream read by the stream and read-ahead sources.
+    const uint8_t *base;    // Start of the data of the mapped and memory sources,
+    size_t length;          // its length in bytes,
+    size_t offset;          // and the offset of the next chunk.
+    void *map;              // Mapping made by the mapped source, and its length.
+    size_t map_length;
+    uint8_t *buf;           // Buffer of the stream source.
+    void *data;             // State of the read-ahead source, or of other sources.
+} SAMPLE_SOURCE;
+
+/*
+ * Open a source over a stdio stream, which must be positioned at the start
+ * of the sample data.
+ *
+ *   @param sp  Source to be opened.
+ *   @param in  Stream from which the data is to be read.
+ *   @param frame  Number of bytes in each frame.
+ *   @param chunk  Maximum number of frames to return from each read.
+ *   @return 0 on success, EOF if the buffer could not be allocated.
+ */
+int source_open_stream(SAMPLE_SOURCE *sp, FILE *in, size_t frame, size_t chunk);
+
+/*
+ * Open a source over a stream that is a regular file, by mapping the file
+ * into memory, with a hint that it will be read sequentially.  The data
+ * starts at the current position of the stream, which is not advanced.
+ *
+ *   @return 0 on success, EOF if the stream is not a regular file or
+ *   could not be mapped.
+ */
+int source_open_mapped(SAMPLE_SOURCE *sp, FILE *in, size_t frame, size_t chunk);
+
+/*
+ * Open a source over sample data in memory.  A trailing partial frame
+ * is ignored.
+ *
+ *   @param data  Start of the sample data.
+ *   @param length  Length of the sample data, in bytes.
+ *   @return 0.
+ */
+int source_open_memory(SAMPLE_SOURCE *sp, const void *data, size_t length,
+                       size_t frame, size_t chunk);
+
+/*
+ * Open a source that reads a stream on a separate thread, one chunk ahead
+ * of the caller.  Nothing else may use the stream until the source has been
+ * closed.
+ *
+ *   @return 0 on success, EOF if the buffers or the thread could not be
+ *   created.
+ */
+int source_open_readahead(SAMPLE_SOURCE *sp, FILE *in, size_t frame, size_t chunk);
+
+/*
+ * Open the best source for a stream: mapped for a regular file, read-ahead
+ * for a pipe or socket, and stream for anything else.
+ *
+ *   @return 0 on success, EOF on failure.
+ */
+int source_open(SAMPLE_SOURCE *sp, FILE *in, size_t frame, size_t chunk);
+
+/*
+ * Read the next chunk of frames from a source.
+ *
+ *   @param sp  Source to be read.
+ *   @param pcmp  Variable into which a pointer to the first frame is stored.
+ *   @return The number of frames available, which is less than sp->chunk
+ *   only at the end of the audio or on error.
+ */
+size_t source_read(SAMPLE_SOURCE *sp, const uint8_t **pcmp);
+
+/*
+ * Close a source.  Any stream that it read is left open.
+ *
+ *   @return 0 if all the data was read successfully, EOF otherwise.
+ */
+int source_close(SAMPLE_SOURCE *sp);
+
+#endif
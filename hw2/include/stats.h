@@ -0,0 +1,77 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "dtmf.h"
+
+/*
+ * Detector instrumentation.
+ *
+ * When the program is built with -DSTATS (make stats), each detector counts
+ * the samples and blocks it analyzes, the blocks accepted and rejected by each
+ * of the tests in detector_classify(), the events it reports, and the time
+ * spent reading input, running the filters, and deciding.  The counts are
+ * printed to stderr at the end of detection.  In a normal build the counting
+ * compiles away to nothing.
+ */
+
+/*
+ * Outcome of classifying a block.
+ */
+#define DETECT_ACCEPT 0            // A DTMF symbol is present.
+#define DETECT_REJECT_FLOOR 1      // Strongest row + column below the floor.
+#define DETECT_REJECT_TWIST 2      // Row to column ratio outside FOUR_DB.
+#define DETECT_REJECT_NEIGHBOR 3   // Another row or column within SIX_DB.
+#define DETECT_NUM_OUTCOMES 4
+
+typedef struct detector_stats {
+    uint64_t samples;                        // Samples analyzed.
+    uint64_t blocks;                         // Blocks completed.
+    uint64_t outcomes[DETECT_NUM_OUTCOMES];  // Blocks by outcome of classification.
+    uint64_t events;                         // Events reported.
+    uint64_t read_ns;                        // Time spent reading input,
+    uint64_t filter_ns;                      // running the filters,
+    uint64_t decide_ns;                      // and classifying and deciding.
+} DETECTOR_STATS;
+
+#ifdef STATS
+#include <time.h>
+
+static inline uint64_t stats_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#define STATS_NOW() stats_now()
+#define STATS_ADD(sp, field, n) ((sp)->field += (n))
+#else
+#define STATS_NOW() 0
+#define STATS_ADD(sp, field, n) ((void)(sp), (void)(n))
+#endif
+
+/*
+ * Add the counts in one set of statistics to another.
+ */
+void stats_add(DETECTOR_STATS *total, const DETECTOR_STATS *sp);
+
+/*
+ * Print a set of statistics in human-readable form.
+ */
+void stats_report(const DETECTOR_STATS *sp, FILE *out);
+
+/*
+ * Record written to the trace file (-T) for each block, in native byte order.
+ */
+typedef struct detector_trace_record {
+    uint32_t channel;       // Channel number (0 for monaural audio).
+    uint32_t start;         // Index of the first sample of the block.
+    double strengths[NUM_DTMF_FREQS];  // Strengths of the DTMF frequencies, rows first.
+    uint8_t symbol;         // Symbol detected, or 0 if none.
+    uint8_t outcome;        // One of the DETECT_ values above.
+    uint8_t pad[6];
+} DETECTOR_TRACE_RECORD;
+
+#endif
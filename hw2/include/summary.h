@@ -0,0 +1,48 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "dtmf.h"
+
+/*
+ * Number of distinct DTMF symbols.
+ */
+#define NUM_DTMF_SYMBOLS (NUM_DTMF_ROW_FREQS * NUM_DTMF_COL_FREQS)
+
+/*
+ * Per-symbol totals over the events reported by one or more detectors,
+ * kept instead of printing the events in summary mode (-O summary).
+ * Symbols are indexed in the order of dtmf_symbol_names, row by row.
+ */
+typedef struct detector_summary {
+    uint64_t count[NUM_DTMF_SYMBOLS];     // Number of events.
+    uint64_t samples[NUM_DTMF_SYMBOLS];   // Total length of the events, in samples.
+    uint32_t shortest[NUM_DTMF_SYMBOLS];  // Length of the shortest event.
+    uint32_t longest[NUM_DTMF_SYMBOLS];   // Length of the longest event.
+} DETECTOR_SUMMARY;
+
+/*
+ * Count one event in a summary.
+ *
+ *   @param sp  Summary to be updated.
+ *   @param symbol  DTMF symbol of the event.
+ *   @param length  Length of the event, in samples.
+ */
+void summary_add_event(DETECTOR_SUMMARY *sp, char symbol, uint32_t length);
+
+/*
+ * Add the totals in one summary to another.
+ */
+void summary_add(DETECTOR_SUMMARY *total, const DETECTOR_SUMMARY *sp);
+
+/*
+ * Print a summary, one line for each symbol that occurred, in the format
+ * "symbol\tcount\ttotal\tshortest\tlongest\n", with the lengths in samples.
+ *
+ *   @return 0 on success, EOF if the output could not be written.
+ */
+int summary_report(const DETECTOR_SUMMARY *sp, FILE *out);
+
+#endif
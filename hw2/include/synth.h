@@ -0,0 +1,58 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "audio.h"
+
+/*
+ * Number of samples synthesized at a time by the DTMF generator.
+ */
+#define GENERATE_BLOCK_SAMPLES 4096
+
+/*
+ * Tone synthesis uses a single table holding one full cycle of cos(), sampled at
+ * AUDIO_FRAME_RATE points.  Since every DTMF frequency is an integral number of Hz,
+ * cos(2 * pi * f * i / AUDIO_FRAME_RATE) is exactly the table entry at index
+ * (f * i) mod AUDIO_FRAME_RATE, so each tone is produced by stepping a phase
+ * accumulator through the table f entries at a time, with no calls to cos()
+ * after the table has been built.
+ */
+#define SYNTH_TABLE_SIZE AUDIO_FRAME_RATE
+
+/*
+ * Build the cosine table.  This is done automatically by synth_tone() the first
+ * time it is called; it only needs to be called explicitly before synthesizing
+ * from more than one thread at once.
+ */
+void synth_init(void);
+
+/*
+ * Synthesize samples of a DTMF tone, as (unrounded) sample values in the range
+ * [-INT16_MAX, INT16_MAX].
+ *
+ *   @param out  Array into which the samples are stored.
+ *   @param index  Index, within the audio output, of the first sample.
+ *   @param n  Number of samples to synthesize.
+ *   @param row  Index in dtmf_freqs of the row frequency of the tone.
+ *   @param col  Index in dtmf_freqs of the column frequency of the tone.
+ */
+void synth_tone(double *out, uint32_t index, size_t n, int row, int col);
+
+/*
+ * Convert a block of synthesized samples to 16-bit audio, optionally mixing
+ * in noise.  The mixed value is tone * (1 - w) + noise * w, truncated toward
+ * zero and saturated to the range of int16_t.  Without noise the tone is
+ * converted as it is.
+ *
+ *   @param out  Array into which the audio samples are stored.
+ *   @param tone  Synthesized samples, as produced by synth_tone().
+ *   @param noise  Noise samples, or NULL for none.
+ *   @param n  Number of samples.
+ *   @param w  Weight of the noise, in [0, 1].
+ */
+void synth_mix(int16_t *out, const double *tone, const int16_t *noise, size_t n, double w);
+
+#endif
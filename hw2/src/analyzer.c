@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "audio.h"
+#include "goertzel.h"
+#include "goertzel_fixed.h"
+#include "analyzer.h"
+#include "debug.h"
+
+int analyzer_init(TONE_ANALYZER *ap, const double *freqs, int ntones,
+                  uint32_t block_size, uint32_t rate) {
+	if (ntones < 0 || ntones > ANALYZER_MAX_TONES) {
+		return -1;
+	}
+	ap->ntones = ntones;
+	ap->lanes = (ntones + ANALYZER_LANES - 1) / ANALYZER_LANES * ANALYZER_LANES;
+	ap->N = block_size;
+	ap->stride = AUDIO_BYTES_PER_SAMPLE;
+	ap->fixed = 0;
+	ap->energy = 0;
+
+	for (int j = 0; j < ap->lanes; j++) {
+		if (j >= ntones) {
+			// padding lanes run a harmless filter whose output is ignored
+			ap->B[j] = ap->Bq[j] = 0;
+			continue;
+		}
+		// the same arithmetic as goertzel_init() and goertzel_strength()
+		GOERTZEL_STATE g;
+		GOERTZEL_FIXED_STATE q;
+		double k = freqs[j] * (1.0 / rate) * block_size;
+		goertzel_init(&g, block_size, k);
+		goertzel_fixed_init(&q, block_size, k);
+		double d = 2 * M_PI * g.k * (g.N - 1) / g.N;
+
+		ap->B[j] = g.B;
+		ap->Bq[j] = q.B;
+		ap->re_C[j] = ap->B[j] / 2.0;
+		ap->im_C[j] = -sin(g.A);
+		ap->re_Cq[j] = cos(q.A);
+		ap->re_D[j] = cos(d);
+		ap->im_D[j] = -sin(d);
+	}
+	analyzer_reset(ap);
+	return 0;
+}
+
+void analyzer_reset(TONE_ANALYZER *ap) {
+	ap->fill = 0;
+	ap->sum_sq = 0;
+	ap->sum_sq_fixed = 0;
+	for (int j = 0; j < ap->lanes; j++) {
+		ap->s1[j] = ap->s2[j] = 0;
+		ap->q1[j] = ap->q2[j] = 0;
+	}
+}
+
+/*
+ * Compute y = (s0 - s1 C) D and return 2 |y|^2 / N^2 for each tone.
+ */
+static void analyzer_strengths(TONE_ANALYZER *ap, const double *s0, const double *s1,
+                               const double *re_C, double *power) {
+	for (int j = 0; j < ap->ntones; j++) {
+		double re_y = s0[j] - s1[j] * re_C[j];
+		double im_y = -s1[j] * ap->im_C[j];
+		double ry = re_y * ap->re_D[j] - im_y * ap->im_D[j];
+		im_y = im_y * ap->re_D[j] + re_y * ap->im_D[j];
+		re_y = ry;
+		power[j] = 2 * (re_y * re_y + im_y * im_y) / (ap->N * ap->N);
+	}
+}
+
+static int analyzer_feed_fixed(TONE_ANALYZER *ap, const uint8_t **pcmp, size_t *nsamplesp,
+                               double *power) {
+	const uint8_t *pcm = *pcmp;
+	size_t nsamples = *nsamplesp;
+	int lanes = ap->lanes;
+	int32_t *B = ap->Bq, *s1 = ap->q1, *s2 = ap->q2;
+	int64_t sum_sq = ap->sum_sq_fixed;
+	int done = 0;
+
+	while (ap->fill < ap->N - 1 && nsamples > 0) {
+		int16_t x = (pcm[0] << 8) | pcm[1];
+		sum_sq += x * x;
+		for (int j = 0; j < lanes; j++) {
+			int32_t s0 = goertzel_fixed_recur(B[j], s1[j], s2[j], x);
+			s2[j] = s1[j];
+			s1[j] = s0;
+		}
+		pcm += ap->stride;
+		nsamples--;
+		ap->fill++;
+	}
+
+	if (nsamples > 0) {
+		// final iteration, back on the scale of samples / INT16_MAX
+		int16_t x = (pcm[0] << 8) | pcm[1];
+		sum_sq += x * x;
+		ap->energy = sum_sq * (1.0 / ((double)INT16_MAX * INT16_MAX)) / ap->N;
+		sum_sq = 0;
+		double s0d[ANALYZER_MAX_TONES], s1d[ANALYZER_MAX_TONES];
+		for (int j = 0; j < ap->ntones; j++) {
+			int32_t s0 = goertzel_fixed_recur(B[j], s1[j], s2[j], x);
+			s0d[j] = s0 * (1.0 / INT16_MAX);
+			s1d[j] = s1[j] * (1.0 / INT16_MAX);
+		}
+		analyzer_strengths(ap, s0d, s1d, ap->re_Cq, power);
+		pcm += ap->stride;
+		nsamples--;
+		analyzer_reset(ap);
+		done = 1;
+	}
+
+	ap->sum_sq_fixed = sum_sq;
+	*pcmp = pcm;
+	*nsamplesp = nsamples;
+	return done;
+}
+
+int analyzer_feed(TONE_ANALYZER *ap, const uint8_t **pcmp, size_t *nsamplesp, double *power) {
+	if (ap->fixed) {
+		return analyzer_feed_fixed(ap, pcmp, nsamplesp, power);
+	}
+
+	const uint8_t *pcm = *pcmp;
+	size_t nsamples = *nsamplesp;
+	int lanes = ap->lanes;
+	analyzer_real *B = ap->B, *s1 = ap->s1, *s2 = ap->s2;
+	double sum_sq = ap->sum_sq;
+	int done = 0;
+
+	// all but the last sample of the block only advance the filters
+	while (ap->fill < ap->N - 1 && nsamples > 0) {
+		int16_t sample = (pcm[0] << 8) | pcm[1];
+		analyzer_real x = sample * (analyzer_real)(1.0 / INT16_MAX);
+		sum_sq += x * x;
+		for (int g = 0; g < lanes; g += ANALYZER_LANES) {
+			// a fixed number of lanes, with no branch and no aliasing: one SIMD step
+			analyzer_real *restrict Bg = B + g, *restrict s1g = s1 + g, *restrict s2g = s2 + g;
+			for (int j = 0; j < ANALYZER_LANES; j++) {
+				analyzer_real s0 = x + Bg[j] * s1g[j] - s2g[j];
+				s2g[j] = s1g[j];
+				s1g[j] = s0;
+			}
+		}
+		pcm += ap->stride;
+		nsamples--;
+		ap->fill++;
+	}
+
+	if (nsamples > 0) {
+		int16_t sample = (pcm[0] << 8) | pcm[1];
+		double x = 1.0 * sample * (1.0 / INT16_MAX);
+		ap->energy = (sum_sq + x * x) / ap->N;
+		sum_sq = 0;
+		double s0[ANALYZER_MAX_TONES], s1d[ANALYZER_MAX_TONES];
+		for (int j = 0; j < ap->ntones; j++) {
+			s0[j] = x + (double)B[j] * s1[j] - s2[j];
+			s1d[j] = s1[j];
+		}
+		analyzer_strengths(ap, s0, s1d, ap->re_C, power);
+		pcm += ap->stride;
+		nsamples--;
+		analyzer_reset(ap);
+		done = 1;
+	}
+
+	ap->sum_sq = sum_sq;
+	*pcmp = pcm;
+	*nsamplesp = nsamples;
+	return done;
+}
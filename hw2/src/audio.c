@@ -15,14 +15,51 @@ int audio_read_sample(FILE *in, int16_t *samplep) {
 	return 0;
 }
 
+size_t audio_read_samples(FILE *in, int16_t *samples, size_t n) {
+	uint8_t bytes[AUDIO_WRITE_CHUNK * AUDIO_BYTES_PER_SAMPLE];
+	size_t total = 0;
+
+	while (n > 0) {
+		size_t chunk = n < AUDIO_WRITE_CHUNK ? n : AUDIO_WRITE_CHUNK;
+		size_t got = fread_unlocked(bytes, AUDIO_BYTES_PER_SAMPLE, chunk, in);
+		for (size_t i = 0; i < got; i++) {
+			samples[i] = (bytes[2 * i] << 8) | bytes[2 * i + 1];
+		}
+		samples += got;
+		total += got;
+		n -= got;
+		if (got < chunk) {
+			break;
+		}
+	}
+	return total;
+}
+
 int audio_write_sample(FILE *out, int16_t sample) {
-	int16_t b = sample & 0x00FF;
-	int16_t a = (sample >> 8);
-	if (fwrite_unlocked(&a, sizeof(uint8_t), 1, out) != 1) {
+	uint8_t bytes[2];
+	bytes[0] = sample >> 8;
+	bytes[1] = sample & 0x00FF;
+	if (fwrite_unlocked(bytes, sizeof(uint8_t), 2, out) != 2) {
 		return EOF;
 	}
-	if (fwrite_unlocked(&b, sizeof(uint8_t), 1, out) != 1) {
-		return EOF;
+	return 0;
+}
+
+int audio_write_samples(FILE *out, const int16_t *samples, size_t n) {
+	uint8_t bytes[AUDIO_WRITE_CHUNK * AUDIO_BYTES_PER_SAMPLE];
+
+	while (n > 0) {
+		size_t chunk = n < AUDIO_WRITE_CHUNK ? n : AUDIO_WRITE_CHUNK;
+		for (size_t i = 0; i < chunk; i++) {
+			bytes[2 * i] = samples[i] >> 8;
+			bytes[2 * i + 1] = samples[i] & 0x00FF;
+		}
+		// a chunk this large bypasses the stdio buffer and goes straight to write()
+		if (fwrite_unlocked(bytes, AUDIO_BYTES_PER_SAMPLE, chunk, out) != chunk) {
+			return EOF;
+		}
+		samples += chunk;
+		n -= chunk;
 	}
 	return 0;
 }
@@ -61,7 +98,7 @@ int audio_read_header(FILE *in, AUDIO_HEADER *hp) {
 	hp->sample_rate = sample_rate;
 	hp->channels = channels;
 
-	if (magic_number != AUDIO_MAGIC || encoding != PCM16_ENCODING || sample_rate != AUDIO_FRAME_RATE || channels != AUDIO_CHANNELS) {
+	if (magic_number != AUDIO_MAGIC || encoding != PCM16_ENCODING || sample_rate == 0 || channels < 1 || channels > AUDIO_MAX_CHANNELS) {
 		// printf("%d\n", magic_number);
 		return EOF;
 	}
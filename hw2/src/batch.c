@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "const.h"
+#include "audio.h"
+#include "detector.h"
+#include "batch.h"
+#include "debug.h"
+
+/*
+ * State shared by the workers: the source of pathnames, which is either an
+ * open directory or an open file list.
+ */
+typedef struct batch_queue {
+    pthread_mutex_t lock;   // Protects everything below.
+    const char *dirname;    // Name of the directory, if dir is being read.
+    DIR *dir;               // Directory being read, or NULL.
+    FILE *list;             // File list being read, or NULL.
+    int failed;             // Nonzero if any file could not be analyzed.
+} BATCH_QUEUE;
+
+/*
+ * State of one worker thread.
+ */
+typedef struct batch_worker {
+    pthread_t thread;
+    BATCH_QUEUE *queue;
+    FILE *out;              // Stream to which events are to be written.
+    uint32_t rate;          // Format for which the detectors are set up,
+    uint32_t channels;      // or 0 if they have not been set up yet.
+    char path[PATH_MAX];    // Pathname of the file being analyzed.
+    DETECTOR_STATS stats;   // Totals over the files analyzed by this worker.
+    DETECTOR_SUMMARY summary;  // Events of the files analyzed by this worker, in summary format.
+    DTMF_DETECTOR detectors[AUDIO_MAX_CHANNELS];
+} BATCH_WORKER;
+
+/*
+ * Get the pathname of the next file to be analyzed into wp->path.
+ * Returns 0 if there is one, EOF if there are no more.
+ */
+static int batch_next(BATCH_WORKER *wp) {
+	BATCH_QUEUE *qp = wp->queue;
+	int ret = EOF;
+
+	pthread_mutex_lock(&qp->lock);
+	if (qp->dir) {
+		struct dirent *de;
+		while ((de = readdir(qp->dir)) != NULL) {
+			if (de->d_name[0] == '.') {
+				continue;
+			}
+			snprintf(wp->path, sizeof(wp->path), "%s/%s", qp->dirname, de->d_name);
+			struct stat st;
+			if (stat(wp->path, &st) == 0 && S_ISREG(st.st_mode)) {
+				ret = 0;
+				break;
+			}
+		}
+	} else {
+		while (fgets(wp->path, sizeof(wp->path), qp->list) != NULL) {
+			char *s = wp->path;
+			while (*s && *s != '\n') {
+				s++;
+			}
+			*s = '\0';
+			if (s != wp->path) {
+				ret = 0;
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&qp->lock);
+	return ret;
+}
+
+/*
+ * Run detection on the file named by wp->path, writing its events to out.
+ */
+static int batch_detect_file(BATCH_WORKER *wp, FILE *out) {
+	FILE *in = fopen(wp->path, "r");
+	if (in == NULL) {
+		return EOF;
+	}
+
+	AUDIO_HEADER header;
+	if (audio_read_header(in, &header) == EOF) {
+		fclose(in);
+		return EOF;
+	}
+	if (header.sample_rate != wp->rate || header.channels != wp->channels) {
+		if (detector_init_channels(wp->detectors, &header, block_size, out) == EOF) {
+			wp->rate = wp->channels = 0;
+			fclose(in);
+			return EOF;
+		}
+		for (int c = 0; c < header.channels; c++) {
+			wp->detectors[c].analyzer.fixed = (global_options & FIXED_OPTION) != 0;
+			wp->detectors[c].adaptive = (global_options & ADAPTIVE_OPTION) != 0;
+			wp->detectors[c].format = output_format;
+		}
+		wp->rate = header.sample_rate;
+		wp->channels = header.channels;
+	} else {
+		for (int c = 0; c < header.channels; c++) {
+			detector_reset(wp->detectors + c, out);
+		}
+	}
+	for (int c = 0; c < header.channels; c++) {
+		wp->detectors[c].tag = wp->path;
+	}
+
+	int ret = detector_run_file(wp->detectors, header.channels, in);
+	for (int c = 0; c < header.channels; c++) {
+		stats_add(&wp->stats, &wp->detectors[c].stats);
+		wp->detectors[c].stats = (DETECTOR_STATS){ 0 };
+		summary_add(&wp->summary, &wp->detectors[c].summary);
+		wp->detectors[c].summary = (DETECTOR_SUMMARY){ 0 };
+	}
+	fclose(in);
+	return ret;
+}
+
+static void *batch_worker(void *arg) {
+	BATCH_WORKER *wp = arg;
+	char *buf = NULL;
+	size_t len = 0;
+	FILE *out = open_memstream(&buf, &len);
+	if (out == NULL) {
+		pthread_mutex_lock(&wp->queue->lock);
+		wp->queue->failed = 1;
+		pthread_mutex_unlock(&wp->queue->lock);
+		return NULL;
+	}
+
+	while (batch_next(wp) == 0) {
+		// collect the events of the file, so that they are printed together
+		rewind(out);
+		if (batch_detect_file(wp, out) == EOF || fflush(out) == EOF) {
+			fprintf(stderr, "%s: cannot analyze\n", wp->path);
+			pthread_mutex_lock(&wp->queue->lock);
+			wp->queue->failed = 1;
+			pthread_mutex_unlock(&wp->queue->lock);
+			continue;
+		}
+		if (len > 0) {
+			flockfile(wp->out);
+			fwrite_unlocked(buf, 1, len, wp->out);
+			funlockfile(wp->out);
+		}
+	}
+
+	fclose(out);
+	free(buf);
+	return NULL;
+}
+
+int dtmf_detect_batch(const char *list, int threads, FILE *events_out) {
+	BATCH_QUEUE queue = { .dirname = list };
+	pthread_mutex_init(&queue.lock, NULL);
+
+	struct stat st;
+	if (stat(list, &st) == -1) {
+		return EOF;
+	}
+	if (S_ISDIR(st.st_mode)) {
+		queue.dir = opendir(list);
+	} else {
+		queue.list = fopen(list, "r");
+	}
+	if (queue.dir == NULL && queue.list == NULL) {
+		return EOF;
+	}
+
+	if (threads == 0) {
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+	if (threads > BATCH_MAX_THREADS) {
+		threads = BATCH_MAX_THREADS;
+	}
+
+	// the workers are large, because of the path buffers and detectors
+	BATCH_WORKER *workers = calloc(threads, sizeof(BATCH_WORKER));
+	int ret = 0;
+	if (workers == NULL) {
+		ret = EOF;
+	} else {
+		int started = 0;
+		for (; started < threads; started++) {
+			workers[started].queue = &queue;
+			workers[started].out = events_out;
+			if (pthread_create(&workers[started].thread, NULL, batch_worker, workers + started) != 0) {
+				break;
+			}
+		}
+		if (started == 0) {
+			// no threads could be created, so do the work here
+			workers->queue = &queue;
+			workers->out = events_out;
+			batch_worker(workers);
+		}
+		for (int i = 0; i < started; i++) {
+			pthread_join(workers[i].thread, NULL);
+		}
+#ifdef STATS
+		DETECTOR_STATS total = { 0 };
+		for (int i = 0; i < threads; i++) {
+			stats_add(&total, &workers[i].stats);
+		}
+		stats_report(&total, stderr);
+#endif
+		if (output_format == DETECT_FORMAT_SUMMARY) {
+			DETECTOR_SUMMARY summary = { 0 };
+			for (int i = 0; i < threads; i++) {
+				summary_add(&summary, &workers[i].summary);
+			}
+			summary_report(&summary, events_out);
+		}
+		free(workers);
+		if (queue.failed) {
+			ret = EOF;
+		}
+	}
+
+	if (queue.dir) {
+		closedir(queue.dir);
+	} else {
+		fclose(queue.list);
+	}
+	pthread_mutex_destroy(&queue.lock);
+	if (fflush(events_out) == EOF || ferror(events_out)) {
+		ret = EOF;
+	}
+	return ret;
+}
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "audio.h"
+#include "detector.h"
+#include "source.h"
+#include "checkpoint.h"
+#include "debug.h"
+
+/*
+ * Configuration of the detectors that made a checkpoint.
+ */
+typedef struct checkpoint_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t channels;
+    uint32_t block_size;
+    uint32_t rate;
+    uint32_t fixed;         // Settings of the detectors that change the
+    uint32_t adaptive;      // events found or how they are reported.
+    uint32_t streaming;
+    uint32_t format;
+    uint32_t real_size;     // sizeof(analyzer_real), which differs between builds.
+} CHECKPOINT_HEADER;
+
+/*
+ * State of the detector for one channel.
+ */
+typedef struct checkpoint_channel {
+    int64_t starting_block;
+    int64_t current_block;
+    int32_t previous_event;
+    int32_t started;
+    double peak[2];
+    uint32_t fill;
+    int64_t sum_sq_fixed;
+    double sum_sq;
+    analyzer_real s1[ANALYZER_MAX_TONES];
+    analyzer_real s2[ANALYZER_MAX_TONES];
+    int32_t q1[ANALYZER_MAX_TONES];
+    int32_t q2[ANALYZER_MAX_TONES];
+    DETECTOR_SUMMARY summary;
+} CHECKPOINT_CHANNEL;
+
+static CHECKPOINT_HEADER checkpoint_header(const DTMF_DETECTOR *dps, int channels) {
+	CHECKPOINT_HEADER hdr = { 0 };
+	hdr.magic = CHECKPOINT_MAGIC;
+	hdr.version = CHECKPOINT_VERSION;
+	hdr.channels = channels;
+	hdr.block_size = dps->block_size;
+	hdr.rate = dps->rate;
+	hdr.fixed = dps->analyzer.fixed;
+	hdr.adaptive = dps->adaptive;
+	hdr.streaming = dps->streaming;
+	hdr.format = dps->format;
+	hdr.real_size = sizeof(analyzer_real);
+	return hdr;
+}
+
+static int checkpoint_header_matches(const CHECKPOINT_HEADER *a, const CHECKPOINT_HEADER *b) {
+	return a->magic == b->magic && a->version == b->version && a->channels == b->channels
+	    && a->block_size == b->block_size && a->rate == b->rate && a->fixed == b->fixed
+	    && a->adaptive == b->adaptive && a->streaming == b->streaming
+	    && a->format == b->format && a->real_size == b->real_size;
+}
+
+int detector_checkpoint(const DTMF_DETECTOR *dps, int channels, FILE *out) {
+	CHECKPOINT_HEADER hdr = checkpoint_header(dps, channels);
+	if (fwrite(&hdr, sizeof(hdr), 1, out) != 1) {
+		return EOF;
+	}
+	for (int c = 0; c < channels; c++) {
+		const DTMF_DETECTOR *dp = dps + c;
+		const TONE_ANALYZER *ap = &dp->analyzer;
+		CHECKPOINT_CHANNEL ch = { 0 };
+		ch.starting_block = dp->starting_block;
+		ch.current_block = dp->current_block;
+		ch.previous_event = dp->previous_event;
+		ch.started = dp->started;
+		ch.peak[0] = dp->peak[0];
+		ch.peak[1] = dp->peak[1];
+		ch.fill = ap->fill;
+		ch.sum_sq_fixed = ap->sum_sq_fixed;
+		ch.sum_sq = ap->sum_sq;
+		for (int j = 0; j < ANALYZER_MAX_TONES; j++) {
+			ch.s1[j] = ap->s1[j];
+			ch.s2[j] = ap->s2[j];
+			ch.q1[j] = ap->q1[j];
+			ch.q2[j] = ap->q2[j];
+		}
+		ch.summary = dp->summary;
+		if (fwrite(&ch, sizeof(ch), 1, out) != 1) {
+			return EOF;
+		}
+	}
+	return 0;
+}
+
+int detector_restore(DTMF_DETECTOR *dps, int channels, FILE *in) {
+	CHECKPOINT_HEADER hdr, expected = checkpoint_header(dps, channels);
+	if (fread(&hdr, sizeof(hdr), 1, in) != 1 || !checkpoint_header_matches(&hdr, &expected)) {
+		return EOF;
+	}
+	CHECKPOINT_CHANNEL chs[AUDIO_MAX_CHANNELS];
+	if (channels > AUDIO_MAX_CHANNELS || fread(chs, sizeof(*chs), channels, in) != (size_t)channels) {
+		return EOF;
+	}
+
+	for (int c = 0; c < channels; c++) {
+		DTMF_DETECTOR *dp = dps + c;
+		TONE_ANALYZER *ap = &dp->analyzer;
+		CHECKPOINT_CHANNEL *ch = chs + c;
+		dp->starting_block = ch->starting_block;
+		dp->current_block = ch->current_block;
+		dp->previous_event = ch->previous_event;
+		dp->started = ch->started;
+		dp->peak[0] = ch->peak[0];
+		dp->peak[1] = ch->peak[1];
+		ap->fill = ch->fill;
+		ap->sum_sq_fixed = ch->sum_sq_fixed;
+		ap->sum_sq = ch->sum_sq;
+		for (int j = 0; j < ANALYZER_MAX_TONES; j++) {
+			ap->s1[j] = ch->s1[j];
+			ap->s2[j] = ch->s2[j];
+			ap->q1[j] = ch->q1[j];
+			ap->q2[j] = ch->q2[j];
+		}
+		dp->summary = ch->summary;
+	}
+	return 0;
+}
+
+/*
+ * Where and how often detector_run_checkpointed() saves checkpoints.
+ */
+typedef struct checkpoint_schedule {
+    const char *path;
+    char *tmp;
+    uint64_t interval;      // In frames.
+    uint64_t next;          // Frame after which the next checkpoint is due.
+} CHECKPOINT_SCHEDULE;
+
+/*
+ * Replace the checkpoint file with the current state of the detectors,
+ * writing a temporary file and renaming it, so that a crash at any moment
+ * leaves either the old checkpoint or the new one.
+ */
+static int checkpoint_save(const DTMF_DETECTOR *dps, int channels, const char *path, char *tmp) {
+	// the checkpoint must not get ahead of the events
+	for (int c = 0; c < channels; c++) {
+		if (fflush(dps[c].out) == EOF) {
+			return EOF;
+		}
+	}
+	FILE *out = fopen(tmp, "w");
+	if (out == NULL) {
+		return EOF;
+	}
+	int ret = detector_checkpoint(dps, channels, out);
+	if (fclose(out) == EOF || ret == EOF || rename(tmp, path) == -1) {
+		remove(tmp);
+		return EOF;
+	}
+	return 0;
+}
+
+/*
+ * Chunk hook of detector_run_checkpointed(): save a checkpoint when one is due.
+ */
+static int checkpoint_hook(DTMF_DETECTOR *dps, int channels, void *arg) {
+	CHECKPOINT_SCHEDULE *sp = arg;
+	if ((uint64_t)dps->current_block < sp->next) {
+		return 0;
+	}
+	if (checkpoint_save(dps, channels, sp->path, sp->tmp) == EOF) {
+		return EOF;
+	}
+	sp->next = dps->current_block + sp->interval;
+	return 0;
+}
+
+/*
+ * Skip the given number of frames of input.
+ */
+static int checkpoint_skip(FILE *in, size_t frame, uint64_t frames) {
+	uint64_t bytes = frames * frame;
+	if (fseeko(in, bytes, SEEK_CUR) == 0) {
+		return 0;
+	}
+	uint8_t buf[DETECT_READ_SAMPLES * AUDIO_BYTES_PER_SAMPLE];
+	while (bytes > 0) {
+		size_t want = bytes < sizeof(buf) ? bytes : sizeof(buf);
+		if (fread(buf, 1, want, in) != want) {
+			return EOF;
+		}
+		bytes -= want;
+	}
+	return 0;
+}
+
+int detector_run_checkpointed(DTMF_DETECTOR *dps, int channels, FILE *in, const char *path) {
+	size_t frame = channels * AUDIO_BYTES_PER_SAMPLE;
+	size_t len = 0;
+	while (path[len] != '\0') {
+		len++;
+	}
+	char *tmp = malloc(len + sizeof(".tmp"));
+	if (tmp == NULL) {
+		return EOF;
+	}
+	for (size_t i = 0; i < len; i++) {
+		tmp[i] = path[i];
+	}
+	for (size_t i = 0; i < sizeof(".tmp"); i++) {
+		tmp[len + i] = ".tmp"[i];
+	}
+
+	FILE *saved = fopen(path, "r");
+	if (saved == NULL && errno != ENOENT) {
+		free(tmp);
+		return EOF;
+	}
+	if (saved) {
+		int ret = detector_restore(dps, channels, saved);
+		fclose(saved);
+		if (ret == EOF || checkpoint_skip(in, frame, dps->current_block) == EOF) {
+			fprintf(stderr, "%s: cannot resume from checkpoint\n", path);
+			free(tmp);
+			return EOF;
+		}
+	}
+
+	SAMPLE_SOURCE src;
+	if (source_open(&src, in, frame, detector_chunk_frames(dps, channels)) == EOF) {
+		free(tmp);
+		return EOF;
+	}
+	CHECKPOINT_SCHEDULE schedule;
+	schedule.path = path;
+	schedule.tmp = tmp;
+	schedule.interval = (uint64_t)CHECKPOINT_SECONDS * dps->rate;
+	schedule.next = dps->current_block + schedule.interval;
+	int ret = detector_run_source_with(dps, channels, &src, checkpoint_hook, &schedule);
+	if (source_close(&src) == EOF) {
+		ret = EOF;
+	}
+	if (ret == 0) {
+		// the scan is complete, so there is nothing to resume
+		remove(path);
+	}
+	free(tmp);
+	return ret;
+}
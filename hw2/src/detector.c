@@ -0,0 +1,357 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "const.h"
+#include "audio.h"
+#include "dtmf.h"
+#include "detector.h"
+#include "debug.h"
+
+void detector_init(DTMF_DETECTOR *dp, int block_size, uint32_t rate,
+                   double *strengths, FILE *out) {
+	double freqs[NUM_DTMF_FREQS];
+	for (int i = 0; i < NUM_DTMF_FREQS; i++) {
+		freqs[i] = dtmf_freqs[i];
+	}
+	analyzer_init(&dp->analyzer, freqs, NUM_DTMF_FREQS, block_size, rate);
+
+	dp->block_size = block_size;
+	dp->rate = rate;
+	dp->min_event = (uint64_t)MIN_EVENT_SAMPLES * rate / AUDIO_FRAME_RATE;
+	dp->channel = -1;
+	dp->tag = NULL;
+	dp->strengths = strengths ? strengths : dp->own_strengths;
+	dp->streaming = 0;
+	dp->adaptive = 0;
+	dp->trace = NULL;
+	dp->format = DETECT_FORMAT_TEXT;
+	dp->stats = (DETECTOR_STATS){ 0 };
+	dp->summary = (DETECTOR_SUMMARY){ 0 };
+	detector_reset(dp, out);
+}
+
+void detector_reset(DTMF_DETECTOR *dp, FILE *out) {
+	analyzer_reset(&dp->analyzer);
+	dp->starting_block = 0;
+	dp->current_block = 0;
+	dp->previous_event = 0;
+	dp->started = 0;
+	dp->peak[0] = dp->peak[1] = 0;
+	dp->out = out;
+}
+
+int detector_init_channels(DTMF_DETECTOR *dps, AUDIO_HEADER *hp, int block_size, FILE *out) {
+	if (hp->sample_rate <= 2 * dtmf_freqs[NUM_DTMF_FREQS - 1]) {
+		// the highest DTMF frequency is above the Nyquist frequency
+		return EOF;
+	}
+	for (int c = 0; c < hp->channels; c++) {
+		DTMF_DETECTOR *dp = dps + c;
+		detector_init(dp, block_size, hp->sample_rate, NULL, out);
+		if (hp->channels > 1) {
+			dp->analyzer.stride = hp->channels * AUDIO_BYTES_PER_SAMPLE;
+			dp->channel = c;
+		}
+	}
+	return 0;
+}
+
+int detector_max_latency(const DTMF_DETECTOR *dp) {
+	int blocks = (dp->min_event + dp->block_size - 1) / dp->block_size;
+	return (dp->block_size - 1) + blocks * dp->block_size;
+}
+
+char detector_classify(const double *strengths) {
+	int outcome;
+	return detector_classify_outcome(strengths, &outcome);
+}
+
+char detector_classify_outcome(const double *strengths, int *outcome) {
+	return detector_classify_floor(strengths, MINUS_20DB, outcome);
+}
+
+double detector_adaptive_floor(double energy) {
+	double floor = ADAPTIVE_RATIO * energy;
+	return floor > ADAPTIVE_MIN_ENERGY ? floor : ADAPTIVE_MIN_ENERGY;
+}
+
+char detector_classify_floor(const double *strengths, double floor, int *outcome) {
+	int row = 0;
+	int col = 4;
+
+	// getting the strongest row and column index
+	for (int j = 0; j < NUM_DTMF_FREQS; j++) {
+		double value = strengths[j];
+		if (j >= NUM_DTMF_ROW_FREQS) {
+			if (value > strengths[col]) {
+				col = j;
+			}
+		} else {
+			if (value > strengths[row]) {
+				row = j;
+			}
+		}
+	}
+
+	double row_value = strengths[row];
+	double col_value = strengths[col];
+
+	if (row_value + col_value < floor) {
+		*outcome = DETECT_REJECT_FLOOR;
+		return 0;
+	}
+
+	// ratio test
+	double ratio = row_value * (1 / col_value);
+	double four_db = FOUR_DB;
+	if (ratio < 1 / four_db || ratio > four_db) {
+		*outcome = DETECT_REJECT_TWIST;
+		return 0;
+	}
+
+	// 6dB test
+	*outcome = DETECT_REJECT_NEIGHBOR;
+	double six_db = SIX_DB;
+	for (int i = 0; i < NUM_DTMF_ROW_FREQS; i++) {
+		if (i != row && row_value * (1 / strengths[i]) < six_db) {
+			return 0;
+		}
+	}
+	for (int i = NUM_DTMF_ROW_FREQS; i < NUM_DTMF_FREQS; i++) {
+		if (i != col && col_value * (1 / strengths[i]) < six_db) {
+			return 0;
+		}
+	}
+
+	*outcome = DETECT_ACCEPT;
+	return dtmf_symbol_names[row][col - NUM_DTMF_ROW_FREQS];
+}
+
+/**
+ * Start a line of output, tagging it with the tag if there is one.
+ */
+static void detector_begin_line(DTMF_DETECTOR *dp) {
+	if (dp->tag) {
+		fprintf(dp->out, "%s\t", dp->tag);
+	}
+}
+
+/**
+ * Finish a line of output, tagging it with the channel number if there is one.
+ */
+static void detector_end_line(DTMF_DETECTOR *dp) {
+	if (dp->channel >= 0) {
+		fprintf(dp->out, "\t%d", dp->channel);
+	}
+	fputc('\n', dp->out);
+}
+
+/**
+ * Report the end of an event.  Events shorter than dp->min_event samples are
+ * discarded.  A streaming detector has already reported tone-start for any
+ * event that is long enough, so it just reports tone-end.
+ */
+static void detector_emit(DTMF_DETECTOR *dp, int64_t start, int64_t end, char c) {
+	if (end - start < dp->min_event) {
+		// not long enough
+		return;
+	}
+	if (!c) {
+		return;
+	}
+	STATS_ADD(&dp->stats, events, 1);
+	if (dp->format == DETECT_FORMAT_BINARY) {
+		DETECTOR_EVENT_RECORD rec = { 0 };
+		rec.start = start;
+		rec.end = end;
+		rec.channel = dp->channel < 0 ? 0 : dp->channel;
+		rec.symbol = c;
+		rec.row_peak = dp->peak[0];
+		rec.col_peak = dp->peak[1];
+		fwrite(&rec, sizeof(rec), 1, dp->out);
+		dp->started = 0;
+		return;
+	}
+	if (dp->format == DETECT_FORMAT_SUMMARY) {
+		summary_add_event(&dp->summary, c, end - start);
+		dp->started = 0;
+		return;
+	}
+	if (dp->streaming) {
+		// a trailing partial block at EOF can make an event long enough late
+		if (!dp->started) {
+			detector_begin_line(dp);
+			fprintf(dp->out, "tone-start\t%" PRId64 "\t%c", start, c);
+			detector_end_line(dp);
+		}
+		detector_begin_line(dp);
+		fprintf(dp->out, "tone-end\t%" PRId64 "\t%" PRId64 "\t%c", start, end, c);
+		detector_end_line(dp);
+		fflush(dp->out);
+		dp->started = 0;
+		return;
+	}
+	detector_begin_line(dp);
+	fprintf(dp->out, "%" PRId64 "\t%" PRId64 "\t%c", start, end, c);
+	detector_end_line(dp);
+}
+
+/**
+ * Update the event state machine with the decision for the block that has
+ * just been completed.
+ */
+static void detector_decide(DTMF_DETECTOR *dp, char event) {
+	if (event) {
+		if (event == dp->previous_event || dp->previous_event == 0) {
+			if (dp->previous_event == 0) {
+				dp->peak[0] = dp->peak[1] = 0;
+			}
+			dp->previous_event = event;
+		} else {
+			detector_emit(dp, dp->starting_block, dp->current_block - dp->block_size, dp->previous_event);
+			dp->starting_block = dp->current_block - dp->block_size;
+			dp->previous_event = event;
+			dp->peak[0] = dp->peak[1] = 0;
+		}
+		// the classifier chose the strongest row and column
+		for (int j = 0; j < NUM_DTMF_FREQS; j++) {
+			double *peak = dp->peak + (j >= NUM_DTMF_ROW_FREQS);
+			if (dp->strengths[j] > *peak) {
+				*peak = dp->strengths[j];
+			}
+		}
+	} else {
+		detector_emit(dp, dp->starting_block, dp->current_block - dp->block_size, dp->previous_event);
+		dp->starting_block = dp->current_block;
+		dp->previous_event = 0;
+	}
+
+	// as soon as the event in progress is long enough to be reported, say so
+	if (dp->streaming && dp->previous_event && !dp->started
+	    && dp->current_block - dp->starting_block >= dp->min_event) {
+		detector_begin_line(dp);
+		fprintf(dp->out, "tone-start\t%" PRId64 "\t%c", dp->starting_block, dp->previous_event);
+		detector_end_line(dp);
+		fflush(dp->out);
+		dp->started = 1;
+	}
+}
+
+/**
+ * Write the trace record for the block that has just been completed.
+ */
+static void detector_trace(DTMF_DETECTOR *dp, char symbol, int outcome) {
+	DETECTOR_TRACE_RECORD rec = { 0 };
+	rec.channel = dp->channel < 0 ? 0 : dp->channel;
+	rec.start = dp->current_block - dp->block_size;
+	for (int j = 0; j < NUM_DTMF_FREQS; j++) {
+		rec.strengths[j] = dp->strengths[j];
+	}
+	rec.symbol = symbol;
+	rec.outcome = outcome;
+	fwrite(&rec, sizeof(rec), 1, dp->trace);
+}
+
+void detector_feed(DTMF_DETECTOR *dp, const uint8_t *pcm, size_t nsamples) {
+	size_t left = nsamples;
+	uint64_t t0 = STATS_NOW();
+	STATS_ADD(&dp->stats, samples, nsamples);
+
+	// the analyzer stops at the end of each block
+	while (analyzer_feed(&dp->analyzer, &pcm, &nsamples, dp->strengths)) {
+		uint64_t t1 = STATS_NOW();
+		STATS_ADD(&dp->stats, filter_ns, t1 - t0);
+		dp->current_block += left - nsamples;
+		left = nsamples;
+
+		int outcome;
+		double floor = dp->adaptive ? detector_adaptive_floor(dp->analyzer.energy) : MINUS_20DB;
+		char symbol = detector_classify_floor(dp->strengths, floor, &outcome);
+		STATS_ADD(&dp->stats, blocks, 1);
+		STATS_ADD(&dp->stats, outcomes[outcome], 1);
+		if (dp->trace) {
+			detector_trace(dp, symbol, outcome);
+		}
+		detector_decide(dp, symbol);
+		t0 = STATS_NOW();
+		STATS_ADD(&dp->stats, decide_ns, t0 - t1);
+	}
+	dp->current_block += left - nsamples;
+	STATS_ADD(&dp->stats, filter_ns, STATS_NOW() - t0);
+}
+
+int detector_finish(DTMF_DETECTOR *dp) {
+	detector_emit(dp, dp->starting_block, dp->current_block, dp->previous_event);
+	if (ferror(dp->out)) {
+		return EOF;
+	}
+	return 0;
+}
+
+int detector_run(DTMF_DETECTOR *dp, FILE *in) {
+	return detector_run_channels(dp, 1, in);
+}
+
+size_t detector_chunk_frames(const DTMF_DETECTOR *dps, int channels) {
+	size_t want = DETECT_READ_SAMPLES / channels;
+	if (dps->streaming && dps->block_size < want) {
+		want = dps->block_size;
+	}
+	return want;
+}
+
+int detector_run_source(DTMF_DETECTOR *dps, int channels, SAMPLE_SOURCE *src) {
+	return detector_run_source_with(dps, channels, src, NULL, NULL);
+}
+
+int detector_run_source_with(DTMF_DETECTOR *dps, int channels, SAMPLE_SOURCE *src,
+                             DETECTOR_CHUNK_HOOK hook, void *arg) {
+	int ret = 0;
+	while (1) {
+		const uint8_t *pcm;
+		uint64_t t0 = STATS_NOW();
+		size_t got = source_read(src, &pcm);
+		STATS_ADD(&dps->stats, read_ns, STATS_NOW() - t0);
+		// each channel's samples start one sample further into the frame
+		for (int c = 0; c < channels; c++) {
+			detector_feed(dps + c, pcm + c * AUDIO_BYTES_PER_SAMPLE, got);
+		}
+		if (got < src->chunk) {
+			break;
+		}
+		if (hook && hook(dps, channels, arg) == EOF) {
+			ret = EOF;
+			break;
+		}
+	}
+
+	for (int c = 0; c < channels; c++) {
+		if (detector_finish(dps + c) == EOF) {
+			ret = EOF;
+		}
+	}
+	return ret;
+}
+
+int detector_run_channels(DTMF_DETECTOR *dps, int channels, FILE *in) {
+	SAMPLE_SOURCE src;
+	if (source_open_stream(&src, in, channels * AUDIO_BYTES_PER_SAMPLE,
+	                       detector_chunk_frames(dps, channels)) == EOF) {
+		return EOF;
+	}
+	int ret = detector_run_source(dps, channels, &src);
+	source_close(&src);
+	return ret;
+}
+
+int detector_run_file(DTMF_DETECTOR *dps, int channels, FILE *in) {
+	SAMPLE_SOURCE src;
+	if (source_open(&src, in, channels * AUDIO_BYTES_PER_SAMPLE,
+	                detector_chunk_frames(dps, channels)) == EOF) {
+		return EOF;
+	}
+	int ret = detector_run_source(dps, channels, &src);
+	source_close(&src);
+	return ret;
+}
@@ -2,54 +2,17 @@
 #include <stdlib.h>
 #include <math.h>
 
-// start of war-crime behaviors
-// this is bad but it is speeding the program
-// it breaks encapsulation, abstraction and make the code more unreadable
-#define GOERTZEL_STEP(gp, x) \
-    do { \
-        (gp)->s0 = (x) + (gp)->B * (gp)->s1 - (gp)->s2; \
-        (gp)->s2 = (gp)->s1; \
-        (gp)->s1 = (gp)->s0; \
-    } while(0)
-
-#define GOERTZEL_STRENGTH(gp, x) \
-    ({ \
-        double strength; \
-        /* s0 = x[N-1] + B * s1 - s2 */ \
-        (gp)->s0 = (x) + (gp)->B * (gp)->s1 - (gp)->s2; \
-        \
-        /* C = exp (-j * A) = cos A - j sin A */ \
-        double re_C, im_C, re_D, im_D; \
-        re_C = (gp)->B / 2; \
-        im_C = -sin((gp)->A); \
-        \
-        /* D = exp (-j * 2 * pi * k * (N - 1) / N) */ \
-        double re_y, im_y; \
-        double d = 2 * M_PI * (gp)->k * ((gp)->N - 1) / (gp)->N; \
-        re_D = cos(d); \
-        im_D = -sin(d); \
-        \
-        /* y = s0 - s1 * C */ \
-        re_y = (gp)->s0 - (gp)->s1 * re_C; \
-        im_y = -(gp)->s1 * im_C; \
-        \
-        /* y = y * D */ \
-        double ry = re_y * re_D - im_y * im_D; \
-        im_y = im_y * re_D + re_y * im_D; \
-        re_y = ry; \
-        \
-        /* Calculate strength */ \
-        strength = 2 * (re_y * re_y + im_y * im_y) / ((gp)->N * (gp)->N); \
-        \
-        strength; \
-    })
-// end of war-crime behaviors
-
 #include "const.h"
 #include "audio.h"
 #include "dtmf.h"
 #include "dtmf_static.h"
 #include "goertzel.h"
+#include "detector.h"
+#include "synth.h"
+#include "events.h"
+#include "batch.h"
+#include "generate.h"
+#include "checkpoint.h"
 #include "debug.h"
 
 #ifdef _STRING_H
@@ -64,40 +27,6 @@
 #error "Do not #include <ctype.h>. You will get a ZERO."
 #endif
 
-int get_row_frequency(char symbol) {
-	for (int i = 0; i < NUM_DTMF_ROW_FREQS; i++) {
-		for (int j = 0; j < NUM_DTMF_COL_FREQS; j++) {
-			if (*(*(dtmf_symbol_names + i) + j) == symbol) {
-				return i;
-			}
-		}
-	}
-
-	return -1;
-}
-
-int get_col_frequency(char symbol) {
-	for (int i = 0; i < NUM_DTMF_ROW_FREQS; i++) {
-		for (int j = 0; j < NUM_DTMF_COL_FREQS; j++) {
-			if (*(*(dtmf_symbol_names + i) + j) == symbol) {
-				return j + 4;
-			}
-		}
-	}
-	return -1;
-}
-
-void preCompute(double *input) {
-	double pi = M_PI;
-	double audio_frame_rate = 8000;
-	double rec_audio_frame_rate = 1.0 / audio_frame_rate;
-	double cos_constant = 2.0 * pi * rec_audio_frame_rate;
-
-	for (int i = 0; i < 8; i++) {
-		input[i] = 2.0 * pi * rec_audio_frame_rate * input[i];
-	}
-}
-
 int char_to_int(char c) {
 	int num = c - '0';
 	if (num < 0 || num > 9) {
@@ -107,10 +36,6 @@ int char_to_int(char c) {
 	}
 }
 
-int dtmf_generate_helper(int num_untrunc, FILE *out) {
-	return audio_write_sample(out, num_untrunc);
-}
-
 double get_w() {
 	double z = pow(10, noise_level / 10.0);
 	// printf("%d\n", noise_level);
@@ -131,6 +56,39 @@ double get_w() {
  * IF YOU VIOLATE THIS RESTRICTION, YOU WILL GET A ZERO!
  */
 
+/*
+ * Fill a block with samples from the noise file.  Past the end of the noise
+ * the block is padded with silence, unless the noise is to be repeated, in
+ * which case reading starts over at the first sample (at offset start).
+ */
+static int read_noise(FILE *in, int16_t *noise, size_t n, long start) {
+	int rewound = 0;
+
+	while (n > 0) {
+		size_t got = audio_read_samples(in, noise, n);
+		noise += got;
+		n -= got;
+		if (got > 0) {
+			rewound = 0;
+		}
+		if (n == 0) {
+			break;
+		}
+		if (start == -1 || rewound) {
+			// not repeating, or there is nothing to repeat
+			for (size_t k = 0; k < n; k++) {
+				noise[k] = 0;
+			}
+			break;
+		}
+		if (fseek(in, start, SEEK_SET) == -1) {
+			return EOF;
+		}
+		rewound = 1;
+	}
+	return 0;
+}
+
 /**
  * DTMF generation main function.
  * DTMF events are read (in textual tab-separated format) from the specified
@@ -150,20 +108,17 @@ double get_w() {
  */
 AUDIO_HEADER empty_header;
 int dtmf_generate(FILE *events_in, FILE *audio_out, uint32_t length) {
-	int starting = 0;
-	int ending = 0;
-	int row_freq = 0;
-	int col_freq = 0;
+	DTMF_EVENT event = { 0 };
+	int more = 1;
 
 	// double pi = M_PI;
 	// double audio_frame_rate = 8000;
 
 	double w = get_w();
-	double one_minus_w = (1 - w);
-	double all_constant[8] = { 697, 770, 852, 941, 1209, 1336, 1477, 1633 };
-	preCompute(all_constant);
-	// double rec_audio_frame_rate = 1.0 / audio_frame_rate;
-	// double cos_constant = 2.0 * pi * rec_audio_frame_rate;
+	double tone[GENERATE_BLOCK_SAMPLES];
+	int16_t noise[GENERATE_BLOCK_SAMPLES];
+	int16_t samples[GENERATE_BLOCK_SAMPLES];
+	long noise_start = -1;
 
 	empty_header.magic_number = AUDIO_MAGIC;
 	empty_header.data_offset = 24;
@@ -176,47 +131,6 @@ int dtmf_generate(FILE *events_in, FILE *audio_out, uint32_t length) {
 		return EOF;
 	}
 
-	// getting the starting number
-	char a = fgetc_unlocked(events_in);
-	if (a != EOF) {
-		while (a != '\t') {
-			if (a == EOF) { break; }
-			if (char_to_int(a) == -1) {
-				return EOF;
-			}
-			starting = starting * 10 + char_to_int(a);
-			a = fgetc_unlocked(events_in);
-		}
-
-		a = fgetc_unlocked(events_in);
-		while (a != '\t') {
-			if (a == EOF) { break; }
-			if (char_to_int(a) == -1) {
-				return EOF;
-			}
-			ending = ending * 10 + char_to_int(a);
-			a = fgetc_unlocked(events_in);
-		}
-
-		a = fgetc_unlocked(events_in);
-		if (a == EOF) { return EOF; }
-		row_freq = get_row_frequency(a);
-		col_freq = get_col_frequency(a);
-		if (row_freq == -1 || col_freq == -1) {
-			return EOF;
-		}
-		fgetc_unlocked(events_in); // Get rid of \n
-		if (a == EOF) { return EOF; }
-	}
-	if (starting > length || ending > length) {
-		return EOF;
-	}
-	if (starting != 0 && ending != 0 && starting >= ending) {
-		return EOF;
-	}
-
-	// printf("%d %d\n", starting, ending);
-	// printf("%d %d\n", row_freq, col_freq);
 	FILE *opened_file = 0;
 	if (noise_file) {
 		opened_file = fopen(noise_file, "r");
@@ -224,97 +138,84 @@ int dtmf_generate(FILE *events_in, FILE *audio_out, uint32_t length) {
 			// printf("Invalid file path\n");
 			return EOF;
 		}
-		if (audio_read_header(opened_file, &empty_header) == EOF) {
+		if (audio_read_header(opened_file, &empty_header) == EOF
+		    || empty_header.sample_rate != AUDIO_FRAME_RATE || empty_header.channels != AUDIO_CHANNELS) {
 			// The file provided was in an incorrect format
 			// printf("File provided was in incorrect format\n");
+			fclose(opened_file);
 			return EOF;
 		}
+		if (global_options & LOOP_OPTION) {
+			noise_start = ftell(opened_file);
+			if (noise_start == -1) {
+				// the noise cannot be repeated without seeking back to the start
+				fclose(opened_file);
+				return EOF;
+			}
+		}
 	}
 
-	for (int i = 0; i < length; i++) {
-		double dtmf = 0;
-		if (i >= starting && i < ending) {
-			double a = cos(i * all_constant[row_freq]);
-			double b = cos(i * all_constant[col_freq]);
-			double c = a * 0.5 + b * 0.5;
-			// printf("%lf %lf %d\n", a, b, INT16_MAX);
-			// printf("%d\n", INT16_MAX);s
-			dtmf = c * INT16_MAX;
-			// printf("%d\n", dtmf);
-		}
-		if (i >= ending) {
-			starting = 0;
-			ending = 0;
-
-			char a = fgetc_unlocked(events_in);
-			if (a != EOF) {
-				while (a != '\t') {
-					if (a == EOF) { break; }
-					if (char_to_int(a) == -1) {
-						return EOF;
-					}
-					starting = starting * 10 + char_to_int(a);
-					a = fgetc_unlocked(events_in);
-				}
+	if (generate_threads > 1) {
+		int ret = generate_parallel(events_in, audio_out, length, opened_file,
+		                            (global_options & LOOP_OPTION) != 0, w, generate_threads);
+		if (ret != GENERATE_SERIAL) {
+			if (opened_file) {
+				fclose(opened_file);
+			}
+			return ret;
+		}
+	}
 
-				a = fgetc_unlocked(events_in);
-				while (a != '\t') {
-					if (a == EOF) { break; }
-					if (char_to_int(a) == -1) {
-						return EOF;
+	uint32_t i = 0;
+	while (i < length) {
+		uint32_t block_start = i;
+		uint32_t block_end = length - i > GENERATE_BLOCK_SAMPLES ? i + GENERATE_BLOCK_SAMPLES : length;
+
+		// synthesize the block a span at a time; the samples up to the next
+		// event boundary all come from the same source
+		while (i < block_end) {
+			if (more && i >= event.end) {
+				more = events_read(events_in, &event, event.end, length);
+				if (more == EOF) {
+					if (opened_file) {
+						fclose(opened_file);
 					}
-					ending = ending * 10 + char_to_int(a);
-					a = fgetc_unlocked(events_in);
-				}
-
-				a = fgetc_unlocked(events_in);
-				if (a == EOF) { return EOF; }
-				row_freq = get_row_frequency(a);
-				col_freq = get_col_frequency(a);
-				if (row_freq == -1 || col_freq == -1) {
 					return EOF;
 				}
-				fgetc_unlocked(events_in); // Get rid of \n
-				if (a == EOF) { return EOF; }
-			}
-			if (starting > length || ending > length) {
-				return EOF;
+				if (!more) {
+					event.start = event.end = 0;
+				}
 			}
-			if (starting < i && starting != 0) {
-				return EOF;
+
+			uint32_t n = block_end - i;
+			if (i < event.start && event.start - i < n) {
+				n = event.start - i;
 			}
-			if (starting != 0 && ending != 0 && starting >= ending) {
-				return EOF;
+			if (i < event.end && event.end - i < n) {
+				n = event.end - i;
 			}
-			if (i >= starting && i < ending) {
-				double a = cos(i * all_constant[row_freq]);
-				double b = cos(i * all_constant[col_freq]);
-				double c = a * 0.5 + b * 0.5;
-				// printf("%lf %lf %d\n", a, b, INT16_MAX);
-				// printf("%d\n", INT16_MAX);s
-				dtmf = c * INT16_MAX;
-				// printf("%d\n", dtmf);
+			if (i >= event.start && i < event.end) {
+				synth_tone(tone + (i - block_start), i, n, event.row, event.col);
+			} else {
+				for (uint32_t k = 0; k < n; k++) {
+					tone[i - block_start + k] = 0;
+				}
 			}
+			i += n;
 		}
 
-		if (opened_file) {
-			int16_t i_real;
-			// printf("\nW: %lf\n", w);
-			int i = audio_read_sample(opened_file, &i_real);
-			if (i != EOF) {
-				// printf("\nNoise: %lf\n", i_real * w);
-				// printf("Value: %lf\n", dtmf * (1 - w));
-				int z = dtmf * one_minus_w + i_real * w;
-				// printf("Final: %d\n", z);
-				dtmf = z;
-				// printf("Final: %d\n", dtmf);
-			} else {
-				dtmf = dtmf * one_minus_w;
+		uint32_t n = block_end - block_start;
+		if (opened_file && read_noise(opened_file, noise, n, noise_start) == EOF) {
+			fclose(opened_file);
+			return EOF;
+		}
+		synth_mix(samples, tone, opened_file ? noise : NULL, n, w);
+		if (audio_write_samples(audio_out, samples, n) == EOF) {
+			if (opened_file) {
+				fclose(opened_file);
 			}
+			return EOF;
 		}
-
-		int dtmf_int = dtmf;
-		dtmf_generate_helper(dtmf_int, audio_out);
 	}
 	if (noise_file && opened_file) {
 		fclose(opened_file);
@@ -322,23 +223,6 @@ int dtmf_generate(FILE *events_in, FILE *audio_out, uint32_t length) {
 	return 0;
 }
 
-int i_to_freq(int i) {
-	if (i == 0) { return 	697; }
-	if (i == 1) { return 	770; }
-	if (i == 2) { return 	852; }
-	if (i == 3) { return 	941; }
-	if (i == 4) { return 	1209; }
-	if (i == 5) { return 	1336; }
-	if (i == 6) { return 	1477; }
-	if (i == 7) { return 	1633; }
-	return -1;
-}
-
-char row_col_to_char(int i, int j) {
-	char c = *(j + *(i + dtmf_symbol_names));
-	return c;
-}
-
 /**
  * DTMF detection main function.
  * This function first reads and validates an audio header from the specified input stream.
@@ -364,185 +248,60 @@ char row_col_to_char(int i, int j) {
  *   @param events_out  Output stream to which DTMF events are to be written.
  *   @return 0  If reading of audio and writing of DTMF events is sucessful, EOF otherwise.
  */
-int output_event(int start, int end, char c, FILE *output) {
-	if (end - start < 250) {
-		// not long enough
-		return 0;
-	}
-	if (!c) {
-		return 0;
-	}
-	fprintf(output, "%d\t%d\t%c\n", start, end, c);
-	// printf("%d\t%d\t%c\n", start, end, c);
-	return 0;
-}
-
-
 int dtmf_detect(FILE *audio_in, FILE *events_out) {
 	if (audio_read_header(audio_in, &empty_header) == EOF) {
 		return EOF;
 	}
-	int starting_block = 0;
-	int current_block = 0;
-	char previous_event = 0;
-
-	int N = block_size;
-	GOERTZEL_STATE local_test[8];
-	for (int i = 0; i < 8; i++) {
-		int frequency = i_to_freq(i);
-		double k = frequency * (1.0 / 8000.0) * N;
-		// printf("%dHz -> %lf\n", frequency, k);
-		// intializing the state
-		GOERTZEL_STATE *x = &(local_test[i]);
-		goertzel_init(x, N, k);
+	int channels = empty_header.channels;
+	DTMF_DETECTOR detectors[AUDIO_MAX_CHANNELS];
+	if (detector_init_channels(detectors, &empty_header, block_size, events_out) == EOF) {
+		return EOF;
 	}
 
-	while (1) {
-	// if (current_block > 0) { break; }
-	// printf("----------------\n");
-	// intializing the stuff
-		// printf("%d\n", current_block);
-		for (int i = 0; i < 8; i++) {
-			GOERTZEL_STATE *x = (i + goertzel_state);
-			*x = local_test[i];
-		}
-
-		for (int i = 0; i < block_size - 1; i++) {
-			// printf("%d\n", i);
-			int16_t dtmf;
-			int result = audio_read_sample(audio_in, &dtmf);
-			if (result == EOF) {
-				break;
-			}
-			current_block += 1;
-			// printf("%d\n", dtmf);
-			double k_temp = 1.0 * dtmf * (1.0 / INT16_MAX);
-			// double k_temp = 1.0 * (((unsigned short)dtmf) >> 15);
-			for (int j = 0; j < 8; j++) {
-				GOERTZEL_STATE *x = (j + goertzel_state);
-				// if (j == 0) {
-				// 	printf("%lf\n", x->s0);
-				// }
-
-				GOERTZEL_STEP(x, k_temp);
-				// x->s0 = k_temp + x->B * x->s1 - x->s2;
-				// x->s2 = x->s1;
-				// x->s1 = x->s0;
-
-				// if (j == 0) {
-				// 	printf("%lf %lf %lf\n", x->s0, x->s1, x->s2);
-				// }
-			}
+	FILE *trace = NULL;
+	if (trace_file) {
+		trace = fopen(trace_file, "w");
+		if (!trace) {
+			return EOF;
 		}
+	}
 
-		// final step
-		int16_t dtmf;
-		int result = audio_read_sample(audio_in, &dtmf);
-		if (result == EOF) {
-			break;
-		}
-		// printf("%d\n", dtmf);
-		current_block += 1;
-		double k_temp = 1.0 * dtmf * (1.0 / INT16_MAX);
-		// double k_temp = 1.0 * (((unsigned short)dtmf) >> 15);
-		for (int j = 0; j < 8; j++) {
-			GOERTZEL_STATE *x = (j + goertzel_state);
-			double strength = GOERTZEL_STRENGTH(x, k_temp);
-			// printf("%d\n", current_block);
-			// printf("%lf\n", strength);
-			*(j + goertzel_strengths) = strength;
-		}
-
-		int row = 0;
-		int col = 4;
-
-		for (int j = 0; j < 8; j++) {
-			// getting the strongest row and column index
-			// printf("%lf\n", *(j + goertzel_strengths));
-			double value = *(j + goertzel_strengths);
-			// printf("%lf\n", value);
-			if (j > 3) {
-				// columns
-				if (value > *(col + goertzel_strengths)) {
-					col = j;
-				}
-			} else {
-				// rows
-				if (value > *(row + goertzel_strengths)) {
-					row = j;
-				}
-			}
+	// channel 0 leaves its strengths in the global array
+	detectors->strengths = goertzel_strengths;
+	for (int c = 0; c < channels; c++) {
+		detectors[c].streaming = (global_options & STREAM_OPTION) != 0;
+		detectors[c].analyzer.fixed = (global_options & FIXED_OPTION) != 0;
+		detectors[c].adaptive = (global_options & ADAPTIVE_OPTION) != 0;
+		detectors[c].trace = trace;
+		detectors[c].format = output_format;
+	}
+	int ret;
+	if (checkpoint_file) {
+		ret = detector_run_checkpointed(detectors, channels, audio_in, checkpoint_file);
+	} else {
+		ret = detector_run_file(detectors, channels, audio_in);
+	}
+	if (output_format == DETECT_FORMAT_SUMMARY) {
+		DETECTOR_SUMMARY summary = { 0 };
+		for (int c = 0; c < channels; c++) {
+			summary_add(&summary, &detectors[c].summary);
 		}
-
-		double row_value = *(row + goertzel_strengths);
-		double col_value = *(col + goertzel_strengths);
-
-		// printf("row: %lf, col: %lf\n", row_value, col_value);
-		// printf("row: %d, col: %d\n", row, col);
-
-		int is_valid = 1;
-
-		if (row_value + col_value >= .01) {
-			// ratio test
-			double ratio = row_value * (1 / col_value);
-			double four_db = FOUR_DB;
-			if (ratio >= 1 / four_db && ratio <= four_db) {
-				// 6dB test
-				double six_db = SIX_DB;
-				for (int i = 0; i < 4; i++) {
-					if (i == row) {
-						continue;
-					} else {
-						double value = *(i + goertzel_strengths);
-						double new_ratio = row_value * (1 / value);
-						if (new_ratio < six_db) {
-							is_valid = 0;
-							break;
-						}
-					}
-				}
-
-				for (int i = 4; i < 8; i++) {
-					if (i == col) {
-						continue;
-					} else {
-						double value = *(i + goertzel_strengths);
-						double new_ratio = col_value * (1 / value);
-						if (new_ratio < six_db) {
-							// printf("col_value: %lf  ratio: %lf\n", col_value, new_ratio);
-							is_valid = 0;
-							break;
-						}
-					}
-				}
-			} else {
-				// printf("strongest row: %lf | strongest col: %lf\n", row_value, col_value);
-				is_valid = 0;
-			}
-		} else {
-			// printf("Broke at B\n");
-			is_valid = 0;
+		if (summary_report(&summary, events_out) == EOF) {
+			ret = EOF;
 		}
+	}
 
-		if (is_valid) {
-			// THIS IS TRUE ONLY IF WE HAVE A VALID EVENT
-			char event = row_col_to_char(row, col - 4);
-			if (event == previous_event || previous_event == 0) {
-				previous_event = event;
-			} else {
-				output_event(starting_block, current_block - block_size, previous_event, events_out);
-				starting_block = current_block - block_size;
-				previous_event = event;
-			}
-		} else {
-			// printf("Current block: %d\n", current_block);
-			output_event(starting_block, current_block - block_size, previous_event, events_out);
-			starting_block = current_block;
-			previous_event = 0;
-		}
-	} // ending the while loop
-	output_event(starting_block, current_block, previous_event, events_out);
-	return 0;
+#ifdef STATS
+	DETECTOR_STATS total = { 0 };
+	for (int c = 0; c < channels; c++) {
+		stats_add(&total, &detectors[c].stats);
+	}
+	stats_report(&total, stderr);
+#endif
+	if (trace && fclose(trace) == EOF) {
+		ret = EOF;
+	}
+	return ret;
 }
 
 int check_str_equal(const char *str1, const char *str2) {
@@ -644,17 +403,29 @@ int validargs(int argc, char **argv) {
 		int t_command_used = 0;
 		int n_command_used = 0;
 		int l_command_used = 0;
+		int r_command_used = 0;
+		int j_command_used = 0;
 
 		int t_command_value = 0;
 		char *n_command_value = NULL;
 		int l_command_value = 0;
+		int j_command_value = 0;
 
 		while (argc > 0) {
 			char *command = *argv;
 			char *argument = *(argv + 1);
 
-			if (argc % 2 == 1) {
-				// Means there is not a corresponding argument for each tag
+			if (check_str_equal(command, "-r")) {
+				if (r_command_used) {
+					return -1;
+				}
+				r_command_used = 1;
+				argv += 1;
+				argc -= 1;
+				continue;
+			}
+			if (argc < 2) {
+				// Means there is not a corresponding argument for this tag
 				return -1;
 			}
 			if (check_str_equal(command, "-t")) {
@@ -682,6 +453,22 @@ int validargs(int argc, char **argv) {
 				argc -= 2;
 				n_command_value = argument;
 				continue;
+			} else if (check_str_equal(command, "-j")) {
+				if (j_command_used) {
+					return -1;
+				}
+				j_command_used = 1;
+				argv += 2;
+				argc -= 2;
+				if (is_valid_str_to_int(argument)) {
+					j_command_value = convert_str_to_int(argument);
+					if (j_command_value < 1 || j_command_value > GENERATE_MAX_THREADS) {
+						return -1;
+					}
+				} else {
+					return -1;
+				}
+				continue;
 			} else if (check_str_equal(command, "-l")) {
 				if (l_command_used) {
 					return -1;
@@ -719,6 +506,10 @@ int validargs(int argc, char **argv) {
 		} else {
 			noise_file = n_command_value;
 		}
+		if (r_command_used) {
+			global_options |= LOOP_OPTION;
+		}
+		generate_threads = j_command_value;
 
 		// printf("noise_file: %s | audio_samples: %d | noise_level: %d\n", noise_file, audio_samples, noise_level);
 
@@ -730,32 +521,183 @@ int validargs(int argc, char **argv) {
 		argv += 1;
 		argc -= 1;
 
-		if (argc > 2) {
-			return -1;
-		}
-		if (argc == 0) {
-			block_size = 100;
-			return 0;
-		}
+		int b_command_used = 0;
+		int s_command_used = 0;
+		int q_command_used = 0;
+		int a_command_used = 0;
+		int batch_command_used = 0;
+		int j_command_used = 0;
+		int trace_command_used = 0;
+		int format_command_used = 0;
+		int checkpoint_command_used = 0;
+
+		int b_command_value = 0;
+		char *batch_command_value = NULL;
+		char *trace_command_value = NULL;
+		char *checkpoint_command_value = NULL;
+		int j_command_value = 0;
+		int format_command_value = DETECT_FORMAT_TEXT;
 
-		char *command = *argv;
-		char *argument = *(argv + 1);
+		while (argc > 0) {
+			char *command = *argv;
 
-		if (check_str_equal(command, "-b")) {
-			if (is_valid_str_to_int(argument)) {
-				int size = convert_str_to_int(argument);
-				if (size < 10 || size > 1000) {
+			if (check_str_equal(command, "-s")) {
+				if (s_command_used) {
+					return -1;
+				}
+				s_command_used = 1;
+				argv += 1;
+				argc -= 1;
+				continue;
+			}
+			if (check_str_equal(command, "-q")) {
+				if (q_command_used) {
 					return -1;
 				}
-				block_size = size;
+				q_command_used = 1;
+				argv += 1;
+				argc -= 1;
+				continue;
+			}
+			if (check_str_equal(command, "-a")) {
+				if (a_command_used) {
+					return -1;
+				}
+				a_command_used = 1;
+				argv += 1;
+				argc -= 1;
+				continue;
+			}
+
+			// the rest of the options take an argument
+			if (argc < 2) {
+				return -1;
+			}
+			char *argument = *(argv + 1);
+			if (check_str_equal(command, "-b")) {
+				if (b_command_used) {
+					return -1;
+				}
+				b_command_used = 1;
+				argv += 2;
+				argc -= 2;
+				if (is_valid_str_to_int(argument)) {
+					b_command_value = convert_str_to_int(argument);
+					if (b_command_value < 10 || b_command_value > 1000) {
+						return -1;
+					}
+				} else {
+					return -1;
+				}
+				continue;
+			} else if (check_str_equal(command, "-B")) {
+				if (batch_command_used) {
+					return -1;
+				}
+				batch_command_used = 1;
+				argv += 2;
+				argc -= 2;
+				batch_command_value = argument;
+				continue;
+			} else if (check_str_equal(command, "-O")) {
+				if (format_command_used) {
+					return -1;
+				}
+				format_command_used = 1;
+				argv += 2;
+				argc -= 2;
+				if (check_str_equal(argument, "text")) {
+					format_command_value = DETECT_FORMAT_TEXT;
+				} else if (check_str_equal(argument, "binary")) {
+					format_command_value = DETECT_FORMAT_BINARY;
+				} else if (check_str_equal(argument, "summary")) {
+					format_command_value = DETECT_FORMAT_SUMMARY;
+				} else {
+					return -1;
+				}
+				continue;
+			} else if (check_str_equal(command, "-C")) {
+				if (checkpoint_command_used) {
+					return -1;
+				}
+				checkpoint_command_used = 1;
+				argv += 2;
+				argc -= 2;
+				checkpoint_command_value = argument;
+				continue;
+			} else if (check_str_equal(command, "-T")) {
+				if (trace_command_used) {
+					return -1;
+				}
+				trace_command_used = 1;
+				argv += 2;
+				argc -= 2;
+				trace_command_value = argument;
+				continue;
+			} else if (check_str_equal(command, "-j")) {
+				if (j_command_used) {
+					return -1;
+				}
+				j_command_used = 1;
+				argv += 2;
+				argc -= 2;
+				if (is_valid_str_to_int(argument)) {
+					j_command_value = convert_str_to_int(argument);
+					if (j_command_value < 1 || j_command_value > BATCH_MAX_THREADS) {
+						return -1;
+					}
+				} else {
+					return -1;
+				}
+				continue;
 			} else {
 				return -1;
 			}
+		}
+
+		if (!b_command_used) {
+			block_size = 100;
 		} else {
+			block_size = b_command_value;
+		}
+		// batch mode writes each file's events at once, so it cannot stream,
+		// and the number of threads only means something in batch mode
+		if (batch_command_used && s_command_used) {
 			return -1;
 		}
-
-		// printf("%d\n", block_size);
+		if (j_command_used && !batch_command_used) {
+			return -1;
+		}
+		// the trace records do not say which file they came from
+		if (trace_command_used && batch_command_used) {
+			return -1;
+		}
+		// tone-start has no place in the other formats, and binary
+		// records do not say which file they came from
+		if (format_command_value != DETECT_FORMAT_TEXT && s_command_used) {
+			return -1;
+		}
+		if (format_command_value == DETECT_FORMAT_BINARY && batch_command_used) {
+			return -1;
+		}
+		// batch mode has no single stream to resume
+		if (checkpoint_command_used && batch_command_used) {
+			return -1;
+		}
+		checkpoint_file = checkpoint_command_value;
+		output_format = format_command_value;
+		trace_file = trace_command_value;
+		batch_list = batch_command_value;
+		batch_threads = j_command_value;
+		if (s_command_used) {
+			global_options |= STREAM_OPTION;
+		}
+		if (q_command_used) {
+			global_options |= FIXED_OPTION;
+		}
+		if (a_command_used) {
+			global_options |= ADAPTIVE_OPTION;
+		}
 
 		return 0;
 	}
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include "const.h"
+#include "dtmf.h"
+#include "events.h"
+#include "debug.h"
+
+/*
+ * Parse an unsigned decimal number that must not exceed max, advancing *sp
+ * past it.  Returns -1 if there are no digits or the number is too large.
+ */
+static int64_t events_parse_index(char **sp, uint32_t max) {
+	char *s = *sp;
+	int64_t value = 0;
+
+	if ((unsigned)(*s - '0') > 9) {
+		return -1;
+	}
+	while ((unsigned)(*s - '0') <= 9) {
+		value = value * 10 + (*s - '0');
+		if (value > max) {
+			return -1;
+		}
+		s++;
+	}
+	*sp = s;
+	return value;
+}
+
+/*
+ * Look up the row and column frequencies of a DTMF symbol.
+ */
+static int events_lookup_symbol(char symbol, int *row, int *col) {
+	for (int i = 0; i < NUM_DTMF_ROW_FREQS; i++) {
+		for (int j = 0; j < NUM_DTMF_COL_FREQS; j++) {
+			if (dtmf_symbol_names[i][j] == (uint8_t)symbol) {
+				*row = i;
+				*col = NUM_DTMF_ROW_FREQS + j;
+				return 0;
+			}
+		}
+	}
+	return -1;
+}
+
+int events_read(FILE *in, DTMF_EVENT *ev, uint32_t prev_end, uint32_t length) {
+	if (fgets(line_buf, LINE_BUF_SIZE, in) == NULL) {
+		return ferror(in) ? EOF : 0;
+	}
+
+	char *s = line_buf;
+	int64_t start = events_parse_index(&s, length);
+	if (start < 0 || *s++ != '\t') {
+		return EOF;
+	}
+	int64_t end = events_parse_index(&s, length);
+	if (end < 0 || *s++ != '\t') {
+		return EOF;
+	}
+	char symbol = *s++;
+	if (*s == '\r') {
+		s++;
+	}
+	if (*s != '\n' && *s != '\0') {
+		// trailing garbage, or a line too long for line_buf
+		return EOF;
+	}
+
+	if (events_lookup_symbol(symbol, &ev->row, &ev->col) == -1) {
+		return EOF;
+	}
+	if (start < prev_end || start >= end) {
+		return EOF;
+	}
+	ev->start = start;
+	ev->end = end;
+	ev->symbol = symbol;
+	return 1;
+}
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "audio.h"
+#include "synth.h"
+#include "events.h"
+#include "generate.h"
+#include "debug.h"
+
+/*
+ * State shared by the workers.
+ */
+typedef struct generate_job {
+    pthread_mutex_t lock;   // Protects next and failed.
+    uint32_t next;          // First sample of the next range to be generated.
+    int failed;             // Nonzero if any range could not be written.
+    uint32_t length;        // Number of samples in the output.
+    DTMF_EVENT *events;     // All the events, in order.
+    size_t nevents;
+    int out_fd;             // Output file, and the offset in it of sample 0.
+    off_t out_base;
+    int noise_fd;           // Noise file, or -1 for none,
+    off_t noise_base;       // the offset in it of its first sample,
+    uint32_t noise_samples; // and the number of samples in it.
+    int noise_loop;         // Nonzero to repeat the noise.
+    double w;               // Weight of the noise.
+} GENERATE_JOB;
+
+/*
+ * Read all the events from a stream into a newly allocated array.
+ */
+static int generate_read_events(FILE *in, uint32_t length, DTMF_EVENT **eventsp, size_t *np) {
+	DTMF_EVENT *events = NULL;
+	size_t n = 0, size = 0;
+	uint32_t prev_end = 0;
+
+	while (1) {
+		if (n == size) {
+			size = size ? 2 * size : 64;
+			DTMF_EVENT *bigger = realloc(events, size * sizeof(DTMF_EVENT));
+			if (bigger == NULL) {
+				free(events);
+				return EOF;
+			}
+			events = bigger;
+		}
+		int ret = events_read(in, events + n, prev_end, length);
+		if (ret == EOF) {
+			free(events);
+			return EOF;
+		}
+		if (ret == 0) {
+			break;
+		}
+		prev_end = events[n++].end;
+	}
+	*eventsp = events;
+	*np = n;
+	return 0;
+}
+
+/*
+ * Index of the first event that ends after sample i.
+ */
+static size_t generate_find_event(GENERATE_JOB *jp, uint32_t i) {
+	size_t lo = 0, hi = jp->nevents;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (jp->events[mid].end <= i) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/*
+ * Read n samples of noise starting at noise index i, wrapping around if the
+ * noise is repeated and padding with silence if not.
+ */
+static int generate_read_noise(GENERATE_JOB *jp, int16_t *noise, uint32_t i, size_t n) {
+	uint8_t bytes[GENERATE_BLOCK_SAMPLES * AUDIO_BYTES_PER_SAMPLE];
+	uint32_t m = jp->noise_samples;
+
+	while (n > 0) {
+		if (jp->noise_loop && m > 0) {
+			i %= m;
+		}
+		size_t k = i < m ? m - i : 0;
+		if (k == 0) {
+			// past the end of noise that is not repeated
+			for (size_t j = 0; j < n; j++) {
+				noise[j] = 0;
+			}
+			break;
+		}
+		if (k > n) {
+			k = n;
+		}
+		size_t want = k * AUDIO_BYTES_PER_SAMPLE;
+		off_t off = jp->noise_base + (off_t)i * AUDIO_BYTES_PER_SAMPLE;
+		for (size_t got = 0; got < want; ) {
+			ssize_t r = pread(jp->noise_fd, bytes + got, want - got, off + got);
+			if (r <= 0) {
+				return EOF;
+			}
+			got += r;
+		}
+		for (size_t j = 0; j < k; j++) {
+			noise[j] = (bytes[2 * j] << 8) | bytes[2 * j + 1];
+		}
+		noise += k;
+		i += k;
+		n -= k;
+	}
+	return 0;
+}
+
+/*
+ * Generate the samples [start, end) and write them to the output.
+ */
+static int generate_range(GENERATE_JOB *jp, uint32_t start, uint32_t end) {
+	double tone[GENERATE_BLOCK_SAMPLES];
+	int16_t noise[GENERATE_BLOCK_SAMPLES];
+	int16_t samples[GENERATE_BLOCK_SAMPLES];
+	uint8_t bytes[GENERATE_BLOCK_SAMPLES * AUDIO_BYTES_PER_SAMPLE];
+	size_t e = generate_find_event(jp, start);
+
+	for (uint32_t block_start = start; block_start < end; block_start += GENERATE_BLOCK_SAMPLES) {
+		uint32_t block_end = end - block_start > GENERATE_BLOCK_SAMPLES
+		                     ? block_start + GENERATE_BLOCK_SAMPLES : end;
+
+		// the same spans as the serial generator: up to the next event boundary
+		for (uint32_t i = block_start; i < block_end; ) {
+			while (e < jp->nevents && jp->events[e].end <= i) {
+				e++;
+			}
+			DTMF_EVENT *ev = e < jp->nevents ? jp->events + e : NULL;
+			uint32_t n = block_end - i;
+			if (ev && i < ev->start && ev->start - i < n) {
+				n = ev->start - i;
+			}
+			if (ev && i >= ev->start) {
+				if (ev->end - i < n) {
+					n = ev->end - i;
+				}
+				synth_tone(tone + (i - block_start), i, n, ev->row, ev->col);
+			} else {
+				for (uint32_t k = 0; k < n; k++) {
+					tone[i - block_start + k] = 0;
+				}
+			}
+			i += n;
+		}
+
+		uint32_t n = block_end - block_start;
+		if (jp->noise_fd >= 0 && generate_read_noise(jp, noise, block_start, n) == EOF) {
+			return EOF;
+		}
+		synth_mix(samples, tone, jp->noise_fd >= 0 ? noise : NULL, n, jp->w);
+		for (uint32_t k = 0; k < n; k++) {
+			bytes[2 * k] = samples[k] >> 8;
+			bytes[2 * k + 1] = samples[k] & 0x00FF;
+		}
+
+		size_t want = n * AUDIO_BYTES_PER_SAMPLE;
+		off_t off = jp->out_base + (off_t)block_start * AUDIO_BYTES_PER_SAMPLE;
+		for (size_t put = 0; put < want; ) {
+			ssize_t r = pwrite(jp->out_fd, bytes + put, want - put, off + put);
+			if (r <= 0) {
+				return EOF;
+			}
+			put += r;
+		}
+	}
+	return 0;
+}
+
+static void *generate_worker(void *arg) {
+	GENERATE_JOB *jp = arg;
+
+	while (1) {
+		pthread_mutex_lock(&jp->lock);
+		uint32_t start = jp->next;
+		int stop = jp->failed || start >= jp->length;
+		if (!stop) {
+			jp->next = jp->length - start > GENERATE_SEGMENT_SAMPLES
+			           ? start + GENERATE_SEGMENT_SAMPLES : jp->length;
+		}
+		uint32_t end = jp->next;
+		pthread_mutex_unlock(&jp->lock);
+		if (stop) {
+			break;
+		}
+
+		if (generate_range(jp, start, end) == EOF) {
+			pthread_mutex_lock(&jp->lock);
+			jp->failed = 1;
+			pthread_mutex_unlock(&jp->lock);
+			break;
+		}
+	}
+	return NULL;
+}
+
+int generate_parallel(FILE *events_in, FILE *audio_out, uint32_t length,
+                      FILE *noise, int noise_loop, double w, int threads) {
+	GENERATE_JOB job = { .length = length, .noise_fd = -1, .noise_loop = noise_loop, .w = w };
+	struct stat st;
+
+	// pwrite() ignores the offset of a file open for appending
+	job.out_fd = fileno(audio_out);
+	int flags = fcntl(job.out_fd, F_GETFL);
+	if (fstat(job.out_fd, &st) == -1 || !S_ISREG(st.st_mode) || flags == -1 || (flags & O_APPEND)) {
+		return GENERATE_SERIAL;
+	}
+	if (noise) {
+		job.noise_fd = fileno(noise);
+		job.noise_base = ftell(noise);
+		if (job.noise_base < 0 || fstat(job.noise_fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+			return GENERATE_SERIAL;
+		}
+		off_t bytes = st.st_size > job.noise_base ? st.st_size - job.noise_base : 0;
+		job.noise_samples = bytes / AUDIO_BYTES_PER_SAMPLE > UINT32_MAX
+		                    ? UINT32_MAX : bytes / AUDIO_BYTES_PER_SAMPLE;
+	}
+
+	if (fflush(audio_out) == EOF || (job.out_base = ftell(audio_out)) < 0) {
+		return EOF;
+	}
+	if (generate_read_events(events_in, length, &job.events, &job.nevents) == EOF) {
+		return EOF;
+	}
+
+	if (threads > GENERATE_MAX_THREADS) {
+		threads = GENERATE_MAX_THREADS;
+	}
+	pthread_t workers[GENERATE_MAX_THREADS];
+	synth_init();
+	pthread_mutex_init(&job.lock, NULL);
+	int started = 0;
+	for (; started < threads; started++) {
+		if (pthread_create(workers + started, NULL, generate_worker, &job) != 0) {
+			break;
+		}
+	}
+	if (started == 0) {
+		// no threads could be created, so do the work here
+		generate_worker(&job);
+	}
+	for (int i = 0; i < started; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	pthread_mutex_destroy(&job.lock);
+	free(job.events);
+
+	// leave the stream where the serial generator would have
+	if (job.failed || fseek(audio_out, job.out_base + (off_t)length * AUDIO_BYTES_PER_SAMPLE,
+	                        SEEK_SET) == -1) {
+		return EOF;
+	}
+	return 0;
+}
@@ -0,0 +1,51 @@
+#include <stdint.h>
+#include <math.h>
+
+#include "debug.h"
+#include "goertzel_fixed.h"
+
+void goertzel_fixed_init(GOERTZEL_FIXED_STATE *gp, uint32_t N, double k) {
+        gp->k = k;
+        gp->N = N;
+        gp->A = 2 * M_PI * k / N;
+        // 2 cos(A) rounds to 2, which Q2.30 cannot hold, when A is below about 2^-15.5
+        double B = 2 * cos(gp->A) * (1L << GOERTZEL_FIXED_COEF_BITS);
+        gp->B = B < INT32_MAX ? (int32_t)lround(B) : INT32_MAX;
+        gp->s0 = gp->s1 = gp->s2 = 0;
+}
+
+void goertzel_fixed_step(GOERTZEL_FIXED_STATE *gp, int16_t x) {
+	gp->s0 = goertzel_fixed_recur(gp->B, gp->s1, gp->s2, x);
+	gp->s2 = gp->s1;
+	gp->s1 = gp->s0;
+}
+
+double goertzel_fixed_strength(GOERTZEL_FIXED_STATE *gp, int16_t x) {
+        gp->s0 = goertzel_fixed_recur(gp->B, gp->s1, gp->s2, x);
+
+        // back to the scale of the double-precision version (samples / INT16_MAX)
+        double s0 = gp->s0 * (1.0 / INT16_MAX);
+        double s1 = gp->s1 * (1.0 / INT16_MAX);
+
+        // C = exp (-j * A) = cos A - j sin A
+        double re_C, im_C, re_D, im_D;
+        re_C = cos(gp->A);
+        im_C = -sin(gp->A);
+
+        // D = exp (-j * 2 * pi * k * (N - 1) / N)
+        double re_y, im_y;
+        double d = 2 * M_PI * gp->k * (gp->N - 1) / gp->N;
+        re_D = cos(d);
+        im_D = -sin(d);
+
+        // y = s0 - s1 * C
+        re_y = s0 - s1 * re_C;
+        im_y = -s1 * im_C;
+
+        // y = y * D
+        double ry = re_y * re_D - im_y * im_D;
+        im_y = im_y * re_D + re_y * im_D;
+        re_y = ry;
+
+	return 2 * (re_y * re_y + im_y * im_y) / (gp->N * gp->N);
+}
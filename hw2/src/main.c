@@ -4,6 +4,7 @@
 #include "const.h"
 #include "debug.h"
 #include "audio.h"
+#include "batch.h"
 
 #ifdef _STRING_H
 #error "Do not #include <string.h>. You will get a ZERO."
@@ -40,6 +41,12 @@ int main(int argc, char **argv)
     if (detect_command_used) {
         // the -d flag was used
             // printf("WHAT\n");
+        if (batch_list) {
+            if (dtmf_detect_batch(batch_list, batch_threads, stdout) == EOF) {
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
+        }
         if (dtmf_detect(stdin, stdout) == EOF) {
             return EXIT_FAILURE;
         }
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "source.h"
+#include "debug.h"
+
+static void source_init(SAMPLE_SOURCE *sp, FILE *in, size_t frame, size_t chunk) {
+	*sp = (SAMPLE_SOURCE){ 0 };
+	sp->in = in;
+	sp->frame = frame;
+	sp->chunk = chunk;
+}
+
+/*
+ * Stream source.
+ */
+static size_t source_stream_read(SAMPLE_SOURCE *sp, const uint8_t **pcmp) {
+	size_t got = fread_unlocked(sp->buf, sp->frame, sp->chunk, sp->in);
+	if (got < sp->chunk) {
+		sp->ended = 1;
+		sp->error = ferror_unlocked(sp->in) != 0;
+	}
+	*pcmp = sp->buf;
+	return got;
+}
+
+static void source_stream_close(SAMPLE_SOURCE *sp) {
+	free(sp->buf);
+}
+
+int source_open_stream(SAMPLE_SOURCE *sp, FILE *in, size_t frame, size_t chunk) {
+	source_init(sp, in, frame, chunk);
+	sp->buf = malloc(frame * chunk);
+	if (sp->buf == NULL) {
+		return EOF;
+	}
+	sp->read = source_stream_read;
+	sp->close = source_stream_close;
+	return 0;
+}
+
+/*
+ * Mapped and memory sources.
+ */
+static size_t source_memory_read(SAMPLE_SOURCE *sp, const uint8_t **pcmp) {
+	size_t left = (sp->length - sp->offset) / sp->frame;
+	size_t got = left < sp->chunk ? left : sp->chunk;
+	if (got < sp->chunk) {
+		sp->ended = 1;
+	}
+	*pcmp = sp->base + sp->offset;
+	sp->offset += got * sp->frame;
+	return got;
+}
+
+static void source_memory_close(SAMPLE_SOURCE *sp) {
+	if (sp->map) {
+		munmap(sp->map, sp->map_length);
+	}
+}
+
+int source_open_memory(SAMPLE_SOURCE *sp, const void *data, size_t length,
+                       size_t frame, size_t chunk) {
+	source_init(sp, NULL, frame, chunk);
+	sp->base = data;
+	sp->length = length;
+	sp->read = source_memory_read;
+	sp->close = source_memory_close;
+	return 0;
+}
+
+int source_open_mapped(SAMPLE_SOURCE *sp, FILE *in, size_t frame, size_t chunk) {
+	struct stat st;
+	long start = ftell(in);
+	if (start < 0 || fstat(fileno(in), &st) == -1 || !S_ISREG(st.st_mode) || st.st_size <= start) {
+		return EOF;
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(in), 0);
+	if (map == MAP_FAILED) {
+		return EOF;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	source_open_memory(sp, (uint8_t *)map + start, st.st_size - start, frame, chunk);
+	sp->in = in;
+	sp->map = map;
+	sp->map_length = st.st_size;
+	return 0;
+}
+
+/*
+ * Read-ahead source.  The reader thread fills the two buffers in turn, and
+ * the caller takes them in the same order; a buffer is full from the time
+ * the reader has filled it until the caller asks for the next chunk.
+ */
+typedef struct readahead {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    // Signalled whenever a buffer is filled or emptied.
+    uint8_t *buf[2];
+    size_t got[2];          // Number of frames in each full buffer.
+    int full[2];
+    int error;              // Nonzero if the reader saw an error.
+    int next;               // Buffer that the caller takes next.
+    int held;               // Buffer that the caller has, or -1 for none.
+    int stop;               // Nonzero to make the reader give up.
+} READAHEAD;
+
+static void *source_readahead_thread(void *arg) {
+	SAMPLE_SOURCE *sp = arg;
+	READAHEAD *rp = sp->data;
+
+	for (int i = 0; ; i ^= 1) {
+		pthread_mutex_lock(&rp->lock);
+		while (rp->full[i] && !rp->stop) {
+			pthread_cond_wait(&rp->cond, &rp->lock);
+		}
+		int stop = rp->stop;
+		pthread_mutex_unlock(&rp->lock);
+		if (stop) {
+			break;
+		}
+
+		// the caller does not touch a buffer that is not full
+		size_t got = fread_unlocked(rp->buf[i], sp->frame, sp->chunk, sp->in);
+
+		pthread_mutex_lock(&rp->lock);
+		rp->got[i] = got;
+		rp->full[i] = 1;
+		if (got < sp->chunk) {
+			rp->error = ferror_unlocked(sp->in) != 0;
+		}
+		pthread_cond_broadcast(&rp->cond);
+		pthread_mutex_unlock(&rp->lock);
+		if (got < sp->chunk) {
+			break;
+		}
+	}
+	return NULL;
+}
+
+static size_t source_readahead_read(SAMPLE_SOURCE *sp, const uint8_t **pcmp) {
+	READAHEAD *rp = sp->data;
+	pthread_mutex_lock(&rp->lock);
+	if (rp->held >= 0) {
+		rp->full[rp->held] = 0;
+		pthread_cond_broadcast(&rp->cond);
+	}
+	while (!rp->full[rp->next]) {
+		pthread_cond_wait(&rp->cond, &rp->lock);
+	}
+	rp->held = rp->next;
+	rp->next ^= 1;
+	size_t got = rp->got[rp->held];
+	if (got < sp->chunk) {
+		sp->ended = 1;
+		sp->error = rp->error;
+	}
+	pthread_mutex_unlock(&rp->lock);
+
+	*pcmp = rp->buf[rp->held];
+	return got;
+}
+
+static void source_readahead_close(SAMPLE_SOURCE *sp) {
+	READAHEAD *rp = sp->data;
+	pthread_mutex_lock(&rp->lock);
+	rp->stop = 1;
+	pthread_cond_broadcast(&rp->cond);
+	pthread_mutex_unlock(&rp->lock);
+	pthread_join(rp->thread, NULL);
+
+	pthread_cond_destroy(&rp->cond);
+	pthread_mutex_destroy(&rp->lock);
+	free(rp->buf[0]);
+	free(rp);
+}
+
+int source_open_readahead(SAMPLE_SOURCE *sp, FILE *in, size_t frame, size_t chunk) {
+	source_init(sp, in, frame, chunk);
+	READAHEAD *rp = calloc(1, sizeof(READAHEAD));
+	if (rp == NULL) {
+		return EOF;
+	}
+	rp->buf[0] = malloc(2 * frame * chunk);
+	if (rp->buf[0] == NULL) {
+		free(rp);
+		return EOF;
+	}
+	rp->buf[1] = rp->buf[0] + frame * chunk;
+	rp->held = -1;
+	pthread_mutex_init(&rp->lock, NULL);
+	pthread_cond_init(&rp->cond, NULL);
+	sp->data = rp;
+	sp->read = source_readahead_read;
+	sp->close = source_readahead_close;
+
+	if (pthread_create(&rp->thread, NULL, source_readahead_thread, sp) != 0) {
+		pthread_cond_destroy(&rp->cond);
+		pthread_mutex_destroy(&rp->lock);
+		free(rp->buf[0]);
+		free(rp);
+		return EOF;
+	}
+	return 0;
+}
+
+int source_open(SAMPLE_SOURCE *sp, FILE *in, size_t frame, size_t chunk) {
+	if (source_open_mapped(sp, in, frame, chunk) == 0) {
+		return 0;
+	}
+	struct stat st;
+	if (fileno(in) >= 0 && fstat(fileno(in), &st) == 0
+	    && (S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode))) {
+		if (source_open_readahead(sp, in, frame, chunk) == 0) {
+			return 0;
+		}
+	}
+	return source_open_stream(sp, in, frame, chunk);
+}
+
+size_t source_read(SAMPLE_SOURCE *sp, const uint8_t **pcmp) {
+	if (sp->ended) {
+		return 0;
+	}
+	return sp->read(sp, pcmp);
+}
+
+int source_close(SAMPLE_SOURCE *sp) {
+	if (sp->close) {
+		sp->close(sp);
+	}
+	return sp->error ? EOF : 0;
+}
@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "stats.h"
+#include "debug.h"
+
+void stats_add(DETECTOR_STATS *total, const DETECTOR_STATS *sp) {
+	total->samples += sp->samples;
+	total->blocks += sp->blocks;
+	for (int i = 0; i < DETECT_NUM_OUTCOMES; i++) {
+		total->outcomes[i] += sp->outcomes[i];
+	}
+	total->events += sp->events;
+	total->read_ns += sp->read_ns;
+	total->filter_ns += sp->filter_ns;
+	total->decide_ns += sp->decide_ns;
+}
+
+void stats_report(const DETECTOR_STATS *sp, FILE *out) {
+	fprintf(out, "samples\t%" PRIu64 "\n", sp->samples);
+	fprintf(out, "blocks\t%" PRIu64 "\n", sp->blocks);
+	fprintf(out, "accepted\t%" PRIu64 "\n", sp->outcomes[DETECT_ACCEPT]);
+	fprintf(out, "rejected-floor\t%" PRIu64 "\n", sp->outcomes[DETECT_REJECT_FLOOR]);
+	fprintf(out, "rejected-twist\t%" PRIu64 "\n", sp->outcomes[DETECT_REJECT_TWIST]);
+	fprintf(out, "rejected-neighbor\t%" PRIu64 "\n", sp->outcomes[DETECT_REJECT_NEIGHBOR]);
+	fprintf(out, "events\t%" PRIu64 "\n", sp->events);
+	fprintf(out, "read-ms\t%.3f\n", sp->read_ns / 1e6);
+	fprintf(out, "filter-ms\t%.3f\n", sp->filter_ns / 1e6);
+	fprintf(out, "decide-ms\t%.3f\n", sp->decide_ns / 1e6);
+}
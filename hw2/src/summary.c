@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "summary.h"
+#include "debug.h"
+
+void summary_add_event(DETECTOR_SUMMARY *sp, char symbol, uint32_t length) {
+	for (int s = 0; s < NUM_DTMF_SYMBOLS; s++) {
+		if (dtmf_symbol_names[s / NUM_DTMF_COL_FREQS][s % NUM_DTMF_COL_FREQS] != (uint8_t)symbol) {
+			continue;
+		}
+		if (sp->count[s] == 0 || length < sp->shortest[s]) {
+			sp->shortest[s] = length;
+		}
+		if (length > sp->longest[s]) {
+			sp->longest[s] = length;
+		}
+		sp->count[s]++;
+		sp->samples[s] += length;
+		return;
+	}
+}
+
+void summary_add(DETECTOR_SUMMARY *total, const DETECTOR_SUMMARY *sp) {
+	for (int s = 0; s < NUM_DTMF_SYMBOLS; s++) {
+		if (sp->count[s] == 0) {
+			continue;
+		}
+		if (total->count[s] == 0 || sp->shortest[s] < total->shortest[s]) {
+			total->shortest[s] = sp->shortest[s];
+		}
+		if (sp->longest[s] > total->longest[s]) {
+			total->longest[s] = sp->longest[s];
+		}
+		total->count[s] += sp->count[s];
+		total->samples[s] += sp->samples[s];
+	}
+}
+
+int summary_report(const DETECTOR_SUMMARY *sp, FILE *out) {
+	for (int s = 0; s < NUM_DTMF_SYMBOLS; s++) {
+		if (sp->count[s] == 0) {
+			continue;
+		}
+		fprintf(out, "%c\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu32 "\t%" PRIu32 "\n",
+		        dtmf_symbol_names[s / NUM_DTMF_COL_FREQS][s % NUM_DTMF_COL_FREQS],
+		        sp->count[s], sp->samples[s], sp->shortest[s], sp->longest[s]);
+	}
+	return ferror(out) ? EOF : 0;
+}
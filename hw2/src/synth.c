@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "audio.h"
+#include "dtmf.h"
+#include "synth.h"
+#include "debug.h"
+
+static double cos_table[SYNTH_TABLE_SIZE];
+static int cos_table_ready = 0;
+
+void synth_init(void) {
+	if (cos_table_ready) {
+		return;
+	}
+	for (int i = 0; i < SYNTH_TABLE_SIZE; i++) {
+		cos_table[i] = cos(2.0 * M_PI * i / SYNTH_TABLE_SIZE);
+	}
+	cos_table_ready = 1;
+}
+
+void synth_tone(double *out, uint32_t index, size_t n, int row, int col) {
+	synth_init();
+
+	uint32_t row_step = dtmf_freqs[row];
+	uint32_t col_step = dtmf_freqs[col];
+	uint32_t row_phase = (uint64_t)row_step * index % SYNTH_TABLE_SIZE;
+	uint32_t col_phase = (uint64_t)col_step * index % SYNTH_TABLE_SIZE;
+
+	for (size_t i = 0; i < n; i++) {
+		double c = cos_table[row_phase] * 0.5 + cos_table[col_phase] * 0.5;
+		out[i] = c * INT16_MAX;
+
+		row_phase += row_step;
+		if (row_phase >= SYNTH_TABLE_SIZE) {
+			row_phase -= SYNTH_TABLE_SIZE;
+		}
+		col_phase += col_step;
+		if (col_phase >= SYNTH_TABLE_SIZE) {
+			col_phase -= SYNTH_TABLE_SIZE;
+		}
+	}
+}
+
+void synth_mix(int16_t *out, const double *tone, const int16_t *noise, size_t n, double w) {
+	if (noise == NULL) {
+		for (size_t i = 0; i < n; i++) {
+			out[i] = (int16_t)tone[i];
+		}
+		return;
+	}
+
+	double one_minus_w = 1 - w;
+	for (size_t i = 0; i < n; i++) {
+		double v = tone[i] * one_minus_w + noise[i] * w;
+		v = v > INT16_MAX ? INT16_MAX : v;
+		v = v < INT16_MIN ? INT16_MIN : v;
+		out[i] = (int16_t)v;
+	}
+}
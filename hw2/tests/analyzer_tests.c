@@ -0,0 +1,103 @@
+#include "test_common.h"
+#include "analyzer.h"
+
+/* Call-progress, fax CNG/CED and a couple of DTMF tones: nine in all, which
+ * is not a multiple of the SIMD lane count. */
+static const double tones[] = {350, 440, 480, 620, 1100, 2100, 697, 1633, 1850};
+#define NTONES ((int)nelem(tones))
+
+/* Relative error allowed against the (double-precision) reference filters */
+#ifdef ANALYZER_FLOAT
+#define POWER_TOLERANCE 1e-3
+#else
+#define POWER_TOLERANCE 1e-9
+#endif
+
+/*
+ * Feed the samples to the analyzer in pieces of varying size, and check every
+ * block's power vector against the reference filters run over the same block.
+ */
+static void compare_with_reference(char *audio, size_t audiolen, int block_size)
+{
+	const uint8_t *pcm = (uint8_t *)audio + sizeof(AUDIO_HEADER);
+	size_t nsamples = (audiolen - sizeof(AUDIO_HEADER)) / sizeof(int16_t);
+	TONE_ANALYZER analyzer;
+	double power[NTONES];
+	size_t base = 0;
+	size_t piece = 1;
+
+	cr_assert_eq(analyzer_init(&analyzer, tones, NTONES, block_size, AUDIO_FRAME_RATE), 0,
+		     "analyzer_init failed");
+	while (nsamples > 0) {
+		size_t n = piece < nsamples ? piece : nsamples;
+		size_t left = n;
+		piece = piece * 7 % 1009 + 1;
+		nsamples -= n;
+		while (analyzer_feed(&analyzer, &pcm, &left, power)) {
+			for (int f = 0; f < NTONES; f++) {
+				GOERTZEL_STATE ref;
+				const uint8_t *bytes = (uint8_t *)audio + sizeof(AUDIO_HEADER) + 2 * base;
+				double expected = 0;
+				ref_goertzel_init(&ref, block_size, tones[f] * block_size / AUDIO_FRAME_RATE);
+				for (int i = 0; i < block_size; i++, bytes += 2) {
+					int16_t sample = (bytes[0] << 8) | bytes[1];
+					double x = ((double)sample) / INT16_MAX;
+					if (i < block_size - 1)
+						ref_goertzel_step(&ref, x);
+					else
+						expected = ref_goertzel_strength(&ref, x);
+				}
+				cr_assert(fabs(power[f] - expected) <= POWER_TOLERANCE * expected + 1e-12,
+					  "Power for %.0fHz in block at sample %zu with N=%d "
+					  "(%.12f != expected value %.12f)",
+					  tones[f], base, block_size, power[f], expected);
+			}
+			base += block_size;
+		}
+		cr_assert_eq(left, 0, "Samples left over after the last block");
+	}
+}
+
+Test(analyzer_suite, matches_reference, .timeout=30)
+{
+	const int duration = 1000;
+	size_t audiolen = sizeof(AUDIO_HEADER) + duration * AUDIO_FRAME_RATE / 1000 * sizeof(int16_t);
+	char *audio = malloc(audiolen);
+	cr_assert(audio != NULL, "Cannot malloc audio buffer");
+	generate_noise(audio, duration);
+
+	int block_sizes[] = {10, 100, 205, 1000};
+	for (int i = 0; i < nelem(block_sizes); i++)
+		compare_with_reference(audio, audiolen, block_sizes[i]);
+	free(audio);
+}
+
+Test(analyzer_suite, finds_tone, .timeout=10)
+{
+	const int block_size = 400;
+	uint8_t pcm[2 * block_size];
+	for (int i = 0; i < block_size; i++) {
+		int16_t sample = (int16_t)(0.5 * INT16_MAX * cos(2.0 * M_PI * 2100 * i / AUDIO_FRAME_RATE));
+		pcm[2 * i] = sample >> 8;
+		pcm[2 * i + 1] = sample & 0xff;
+	}
+
+	TONE_ANALYZER analyzer;
+	double power[NTONES];
+	const uint8_t *p = pcm;
+	size_t n = block_size;
+	analyzer_init(&analyzer, tones, NTONES, block_size, AUDIO_FRAME_RATE);
+	cr_assert(analyzer_feed(&analyzer, &p, &n, power), "Block was not completed");
+
+	int strongest = 0;
+	for (int f = 1; f < NTONES; f++)
+		if (power[f] > power[strongest])
+			strongest = f;
+	cr_assert_eq(tones[strongest], 2100, "Strongest tone is %.0fHz, expected 2100Hz",
+		     tones[strongest]);
+	/* A pure tone puts (nearly) all the power of the block in its bin */
+	cr_assert(fabs(analyzer.energy - 0.125) < 1e-3, "Block energy is %g, expected 0.125",
+		  analyzer.energy);
+	cr_assert(fabs(power[strongest] / analyzer.energy - 1) < 0.05,
+		  "Tone carries %g of the block energy", power[strongest] / analyzer.energy);
+}
@@ -145,3 +145,25 @@ Test(audio_suite, write_sample_normal, .timeout=10){
 
     free(buf);
 }
+
+Test(audio_suite, write_samples_block, .timeout=10){
+    int n = AUDIO_WRITE_CHUNK + 3; // more than one chunk
+    int16_t *samples = malloc(n * sizeof(int16_t));
+    for (int i = 0; i < n; i++)
+	samples[i] = (int16_t)(i * 7919);
+    char* buf = calloc(2 * n + 1, 1);
+    FILE* out = fmemopen(buf, 2 * n + 1, "w");
+    int ret = audio_write_samples(out, samples, n);
+    fclose(out);
+
+    cr_assert_eq(ret, 0,
+		 "Invalid return for audio_write_samples.  Got: %d | Expected: %d", ret, 0);
+    for (int i = 0; i < n; i++) {
+	int16_t got = (int16_t)(((uint8_t)buf[2*i] << 8) | (uint8_t)buf[2*i+1]);
+	cr_assert_eq(got, samples[i],
+		     "Sample %d not written correctly. Got: 0x%hx | Expected: 0x%hx", i, got, samples[i]);
+    }
+
+    free(buf);
+    free(samples);
+}
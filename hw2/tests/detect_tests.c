@@ -1,4 +1,7 @@
+#include <inttypes.h>
 #include "test_common.h"
+#include "batch.h"
+#include "detector.h"
 
 struct _test_context {
 	int duration;
@@ -418,3 +421,363 @@ Test(detect_suite, larger_block, .timeout=10)
 
 	cleanup_test(&ctx);
 }
+
+Test(detect_suite, streaming, .timeout=10)
+{
+	struct _dtmf_event given_events[] = {{0, 1000, '0'},
+					     {1000, 2000, '1'},
+					     {4000, 4200, '2'}};
+	int N = nelem(given_events);
+	const int duration_ms = 1000;
+	const int output_sz = 4096;
+
+	struct _test_context ctx;
+	setup_test(&ctx, given_events, N, duration_ms, output_sz, false, 0);
+
+	/* Execute dtmf_detect in streaming mode - output is written to ctx.fout */
+	block_size = 100;
+	global_options = DETECT_OPTION | STREAM_OPTION;
+	dtmf_detect(ctx.fin, ctx.fout);
+
+	/* Validate result: the 200-sample event is too short to be reported */
+	const char *expected = "tone-start\t0\t0\n"
+			       "tone-end\t0\t1000\t0\n"
+			       "tone-start\t1000\t1\n"
+			       "tone-end\t1000\t2000\t1\n";
+	fflush(ctx.fout);
+	cr_assert(!strncmp(ctx.output, expected, strlen(expected) + 1),
+		  "Streamed events differ from given ones.\n"
+		  "Output text is:\n%s\n",
+		  ctx.output);
+
+	cleanup_test(&ctx);
+}
+
+/* Sample i of the tone for symbol c at the given rate, or 0 if c is 0 */
+static int16_t tone_sample(char c, int i, int rate)
+{
+	static const char symbols[] = "123A456B789C*0#D";
+	static const int rowfreqs[] = {697, 770, 852, 941};
+	static const int colfreqs[] = {1209, 1336, 1477, 1633};
+
+	if (!c)
+		return 0;
+	int s = strchr(symbols, c) - symbols;
+	double v = 0.5 * cos(2.0 * M_PI * rowfreqs[s / 4] * i / rate) +
+		   0.5 * cos(2.0 * M_PI * colfreqs[s % 4] * i / rate);
+	return (int16_t)(v * INT16_MAX);
+}
+
+Test(detect_suite, stereo_16k, .timeout=10)
+{
+	const int rate = 16000;
+	const int nframes = 2 * rate;
+	size_t input_len = sizeof(AUDIO_HEADER) + nframes * 2 * sizeof(int16_t);
+	char *input = malloc(input_len);
+	char output[4096];
+	AUDIO_HEADER hdr = {AUDIO_MAGIC, AUDIO_DATA_OFFSET, nframes * 2 * sizeof(int16_t),
+			    PCM16_ENCODING, rate, 2};
+
+	/* Channel 0 has '5' on [0, 8000); channel 1 has '9' on [4000, 16000)
+	 * and a '#' on [20000, 20400) that is too short at this rate */
+	FILE *fin = fmemopen(input, input_len, "w");
+	ref_audio_write_header(fin, &hdr);
+	for (int i = 0; i < nframes; i++) {
+		ref_audio_write_sample(fin, tone_sample(i < 8000 ? '5' : 0, i, rate));
+		ref_audio_write_sample(fin, tone_sample(i >= 4000 && i < 16000 ? '9' :
+						       i >= 20000 && i < 20400 ? '#' : 0, i, rate));
+	}
+	fclose(fin);
+
+	fin = fmemopen(input, input_len, "r");
+	FILE *fout = fmemopen(output, sizeof(output), "w");
+	block_size = 200;
+	global_options = DETECT_OPTION;
+	int ret = dtmf_detect(fin, fout);
+	fclose(fout);
+	fclose(fin);
+	free(input);
+
+	const char *expected = "0\t8000\t5\t0\n"
+			       "4000\t16000\t9\t1\n";
+	cr_assert_eq(ret, 0, "dtmf_detect failed on stereo audio (%d)", ret);
+	cr_assert(!strcmp(output, expected),
+		  "Events differ from given ones.\n"
+		  "Output text is:\n%s\n",
+		  output);
+}
+
+Test(detect_suite, streaming_latency, .timeout=10)
+{
+	const int rate = 16000;
+	const int nframes = 12000, onset = 3001;
+	char input[nframes * sizeof(int16_t)];
+	char output[4096] = {0};
+
+	/* '7' on [3001, 9000), starting just after a block boundary */
+	FILE *fin = fmemopen(input, sizeof(input), "w");
+	for (int i = 0; i < nframes; i++)
+		ref_audio_write_sample(fin, tone_sample(i >= onset && i < 9000 ? '7' : 0, i, rate));
+	fclose(fin);
+
+	FILE *fout = fmemopen(output, sizeof(output), "w");
+	DTMF_DETECTOR detector;
+	detector_init(&detector, 205, rate, NULL, fout);
+	detector.streaming = 1;
+
+	/* Feed one sample at a time, noting when tone-start comes out */
+	int reported = -1;
+	for (int i = 0; i < nframes; i++) {
+		detector_feed(&detector, (uint8_t *)input + i * sizeof(int16_t), 1);
+		if (reported < 0 && strstr(output, "tone-start"))
+			reported = i + 1;
+	}
+	detector_finish(&detector);
+	fclose(fout);
+
+	int bound = detector_max_latency(&detector);
+	cr_assert(reported >= 0, "tone-start was never reported.\nOutput text is:\n%s\n", output);
+	cr_assert(reported - onset <= bound,
+		  "tone-start came %d samples after the onset, more than the bound of %d",
+		  reported - onset, bound);
+	/* min_event is scaled to the rate, so the bound is too */
+	cr_assert_eq(bound, 204 + 3 * 205, "Bound %d does not use the scaled min_event", bound);
+}
+
+Test(detect_suite, batch, .timeout=10)
+{
+	struct _dtmf_event events[][2] = {{{0, 1000, '0'}, {1000, 2000, '1'}},
+					  {{500, 1500, '#'}, {4000, 6000, 'D'}}};
+	char *names[] = {"batch_a.au", "batch_b.au"};
+	char *list_name = "batch_list.txt";
+	const int duration_ms = 1000;
+	size_t len = sizeof(AUDIO_HEADER) + duration_ms * AUDIO_FRAME_RATE / 1000 * sizeof(int16_t);
+	char audio[len];
+
+	FILE *list = fopen(list_name, "w");
+	for (int i = 0; i < 2; i++) {
+		generate_dtmf_audio(events[i], 2, audio, len, NULL, 0, 0);
+		FILE *f = fopen(names[i], "w");
+		fwrite(audio, 1, len, f);
+		fclose(f);
+		fprintf(list, "%s\n", names[i]);
+	}
+	fprintf(list, "batch_missing.au\n");
+	fclose(list);
+
+	char output[4096] = {0};
+	FILE *fout = fmemopen(output, sizeof(output), "w");
+	block_size = 100;
+	global_options = DETECT_OPTION;
+	int ret = dtmf_detect_batch(list_name, 2, fout);
+	fclose(fout);
+	unlink(names[0]);
+	unlink(names[1]);
+	unlink(list_name);
+
+	/* The missing file is reported, but the others are still analyzed */
+	cr_assert_eq(ret, EOF, "Expected failure for the missing file");
+	const char *expected[] = {"batch_a.au\t0\t1000\t0\nbatch_a.au\t1000\t2000\t1\n",
+				  "batch_b.au\t500\t1500\t#\nbatch_b.au\t4000\t6000\tD\n"};
+	for (int i = 0; i < 2; i++)
+		cr_assert(strstr(output, expected[i]),
+			  "Events of %s are missing.\nOutput text is:\n%s\n",
+			  names[i], output);
+	cr_assert_eq(strlen(output), strlen(expected[0]) + strlen(expected[1]),
+		     "Unexpected output.\nOutput text is:\n%s\n", output);
+}
+
+Test(detect_suite, classify_outcome, .timeout=10)
+{
+	/* rows 697 770 852 941, columns 1209 1336 1477 1633 */
+	double quiet[] = {.001, 0, 0, 0, .001, 0, 0, 0};
+	double twisted[] = {.5, 0, 0, 0, .1, 0, 0, 0};
+	double crowded[] = {.5, .2, 0, 0, .5, 0, 0, 0};
+	double five[] = {0, .5, 0, 0, 0, .5, 0, 0};
+	int outcome;
+
+	cr_assert_eq(detector_classify_outcome(quiet, &outcome), 0, "Expected no symbol");
+	cr_assert_eq(outcome, DETECT_REJECT_FLOOR, "Wrong outcome %d", outcome);
+	cr_assert_eq(detector_classify_outcome(twisted, &outcome), 0, "Expected no symbol");
+	cr_assert_eq(outcome, DETECT_REJECT_TWIST, "Wrong outcome %d", outcome);
+	cr_assert_eq(detector_classify_outcome(crowded, &outcome), 0, "Expected no symbol");
+	cr_assert_eq(outcome, DETECT_REJECT_NEIGHBOR, "Wrong outcome %d", outcome);
+	cr_assert_eq(detector_classify_outcome(five, &outcome), '5', "Expected symbol 5");
+	cr_assert_eq(outcome, DETECT_ACCEPT, "Wrong outcome %d", outcome);
+}
+
+Test(detect_suite, trace, .timeout=10)
+{
+	struct _dtmf_event given_events[] = {{0, 1000, '0'}};
+	const int duration_ms = 1000;
+	struct _test_context ctx;
+	setup_test(&ctx, given_events, nelem(given_events), duration_ms, 4096, false, 0);
+
+	char *trace_name = "detect_trace.bin";
+	block_size = 100;
+	global_options = DETECT_OPTION;
+	trace_file = trace_name;
+	int ret = dtmf_detect(ctx.fin, ctx.fout);
+	trace_file = NULL;
+	cr_assert_eq(ret, 0, "dtmf_detect failed (%d)", ret);
+
+	/* One record per block, with the decision for that block */
+	FILE *f = fopen(trace_name, "r");
+	DETECTOR_TRACE_RECORD rec;
+	int n = 0;
+	while (fread(&rec, sizeof(rec), 1, f) == 1) {
+		cr_assert_eq(rec.start, n * block_size, "Wrong block start %u", rec.start);
+		cr_assert_eq(rec.symbol, rec.start < 1000 ? '0' : 0,
+			     "Wrong symbol in block at %u", rec.start);
+		n++;
+	}
+	fclose(f);
+	unlink(trace_name);
+	cr_assert_eq(n, ctx.nsamples / block_size, "Wrong number of trace records %d", n);
+
+	cleanup_test(&ctx);
+}
+
+Test(detect_suite, mapped_file, .timeout=10)
+{
+	struct _dtmf_event events[] = {{0, 1000, '0'}, {1000, 2000, '1'}};
+	const char *name = "mapped.au";
+	const int duration_ms = 1000;
+	size_t len = sizeof(AUDIO_HEADER) + duration_ms * AUDIO_FRAME_RATE / 1000 * sizeof(int16_t);
+	char audio[len];
+	generate_dtmf_audio(events, nelem(events), audio, len, NULL, 0, 0);
+
+	/* Rewrite the header with an eight-byte annotation, and leave a
+	 * stray byte at the end that does not make up a whole sample */
+	AUDIO_HEADER hdr = {AUDIO_MAGIC, AUDIO_DATA_OFFSET + 8, len - sizeof(AUDIO_HEADER),
+			    PCM16_ENCODING, AUDIO_FRAME_RATE, AUDIO_CHANNELS};
+	FILE *f = fopen(name, "w");
+	ref_audio_write_header(f, &hdr);
+	fwrite("comment", 1, 8, f);
+	fwrite(audio + sizeof(AUDIO_HEADER), 1, len - sizeof(AUDIO_HEADER), f);
+	fputc(0x7f, f);
+	fclose(f);
+
+	char output[4096] = {0};
+	FILE *fin = fopen(name, "r");
+	FILE *fout = fmemopen(output, sizeof(output), "w");
+	block_size = 100;
+	global_options = DETECT_OPTION;
+	int ret = dtmf_detect(fin, fout);
+	fclose(fout);
+	fclose(fin);
+	unlink(name);
+
+	const char *expected = "0\t1000\t0\n1000\t2000\t1\n";
+	cr_assert_eq(ret, 0, "dtmf_detect failed on a regular file (%d)", ret);
+	cr_assert(!strcmp(output, expected),
+		  "Events differ from given ones.\n"
+		  "Output text is:\n%s\n",
+		  output);
+}
+
+Test(detect_suite, adaptive_quiet, .timeout=10)
+{
+	struct _dtmf_event given_events[] = {{0, 1000, '0'}, {1000, 2000, '1'}};
+	const char *expected = "0\t1000\t0\n1000\t2000\t1\n";
+	struct _test_context ctx;
+	setup_test(&ctx, given_events, nelem(given_events), 1000, 4096, false, 0);
+
+	/* Attenuate the tones by 26 dB, which puts them below the fixed floor */
+	for (size_t i = sizeof(AUDIO_HEADER); i + 1 < ctx.input_buf_len; i += 2) {
+		int16_t s = (uint8_t)ctx.input[i] << 8 | (uint8_t)ctx.input[i + 1];
+		s /= 20;
+		ctx.input[i] = s >> 8;
+		ctx.input[i + 1] = s;
+	}
+
+	block_size = 100;
+	global_options = DETECT_OPTION;
+	dtmf_detect(ctx.fin, ctx.fout);
+	fflush(ctx.fout);
+	cr_assert_eq(ftell(ctx.fout), 0, "Events found below the fixed floor:\n%s\n",
+		     ctx.output);
+
+	rewind(ctx.fin);
+	global_options = DETECT_OPTION | ADAPTIVE_OPTION;
+	dtmf_detect(ctx.fin, ctx.fout);
+	fputc('\0', ctx.fout);
+	fflush(ctx.fout);
+	cr_assert(!strcmp(ctx.output, expected),
+		  "Adaptive events differ from given ones.\n"
+		  "Output text is:\n%s\n",
+		  ctx.output);
+
+	cleanup_test(&ctx);
+}
+
+Test(detect_suite, binary_records, .timeout=10)
+{
+	struct _dtmf_event given_events[] = {{0, 1000, '0'},
+					     {1000, 2000, '1'},
+					     {4000, 6000, '#'}};
+	DETECTOR_EVENT_RECORD recs[4];
+	struct _test_context ctx;
+	setup_test(&ctx, given_events, nelem(given_events), 1000, sizeof(recs), false, 0);
+
+	block_size = 100;
+	global_options = DETECT_OPTION;
+	output_format = DETECT_FORMAT_BINARY;
+	int ret = dtmf_detect(ctx.fin, ctx.fout);
+	output_format = DETECT_FORMAT_TEXT;
+	fflush(ctx.fout);
+	long len = ftell(ctx.fout);
+	memcpy(recs, ctx.output, sizeof(recs));
+
+	cr_assert_eq(ret, 0, "dtmf_detect failed (%d)", ret);
+	cr_assert_eq(sizeof(DETECTOR_EVENT_RECORD), 32, "Records are %zu bytes, expected 32",
+		     sizeof(DETECTOR_EVENT_RECORD));
+	cr_assert_eq(len, 3 * 32, "Wrote %ld bytes, expected 3 records", len);
+	for (int i = 0; i < 3; i++) {
+		cr_assert(recs[i].start == given_events[i].start_index &&
+			  recs[i].end == given_events[i].end_index &&
+			  recs[i].symbol == given_events[i].symbol &&
+			  recs[i].channel == 0,
+			  "Record %d is %" PRIu64 "\t%" PRIu64 "\t%c, expected %u\t%u\t%c", i,
+			  recs[i].start, recs[i].end, recs[i].symbol, given_events[i].start_index,
+			  given_events[i].end_index, given_events[i].symbol);
+		/* Each of the two tones has amplitude 1/2 of full scale */
+		cr_assert(recs[i].row_peak > 0.1 && recs[i].row_peak < 0.15 &&
+			  recs[i].col_peak > 0.1 && recs[i].col_peak < 0.15,
+			  "Peak strengths of record %d are %f and %f, expected about 0.125",
+			  i, recs[i].row_peak, recs[i].col_peak);
+	}
+
+	cleanup_test(&ctx);
+}
+
+Test(detect_suite, summary, .timeout=10)
+{
+	struct _dtmf_event given_events[] = {{0, 1000, '0'},
+					     {1000, 2000, '1'},
+					     {2500, 3000, '0'},
+					     {4000, 6000, '#'},
+					     {7000, 7200, '#'}};
+	struct _test_context ctx;
+	setup_test(&ctx, given_events, nelem(given_events), 1000, 4096, false, 0);
+
+	block_size = 100;
+	global_options = DETECT_OPTION;
+	output_format = DETECT_FORMAT_SUMMARY;
+	int ret = dtmf_detect(ctx.fin, ctx.fout);
+	output_format = DETECT_FORMAT_TEXT;
+	fputc('\0', ctx.fout);
+	fflush(ctx.fout);
+
+	/* Symbols in keypad order; the short '#' is not an event */
+	const char *expected = "1\t1\t1000\t1000\t1000\n"
+			       "0\t2\t1500\t500\t1000\n"
+			       "#\t1\t2000\t2000\t2000\n";
+	cr_assert_eq(ret, 0, "dtmf_detect failed (%d)", ret);
+	cr_assert(!strcmp(ctx.output, expected),
+		  "Summary differs from the expected one.\n"
+		  "Output text is:\n%s\n",
+		  ctx.output);
+
+	cleanup_test(&ctx);
+}
@@ -1,4 +1,6 @@
 #include "test_common.h"
+#include "synth.h"
+#include "events.h"
 
 struct _test_context {
 	int duration;
@@ -286,3 +288,155 @@ Test(generate_suite, short_noise, .timeout=10)
 	unlink(noise_file_name);
 	cleanup_test(&ctx);
 }
+
+Test(generate_suite, repeated_noise, .timeout=10)
+{
+	struct _dtmf_event events[] = {{600, 900, 'C'},
+				       {1000, 2000, '*'},
+				       {3600, 8000, 'A'},
+				       {9000, 9600, '9'}};
+
+	char *noise_file_name = "randnoise4.au";
+	const size_t noise_samples = 300 * AUDIO_FRAME_RATE / 1000;
+	const size_t noise_data_len =
+	    sizeof(AUDIO_HEADER) + noise_samples * sizeof(int16_t);
+	const size_t output_samples = 1500 * AUDIO_FRAME_RATE / 1000;
+	struct _test_context ctx;
+	char noise_data[noise_data_len];
+	char repeated_data[sizeof(AUDIO_HEADER) + output_samples * sizeof(int16_t)];
+
+	setup_test(&ctx, events, nelem(events), 1500, 4096);
+	generate_noise_file(noise_file_name, noise_data, 300);
+
+	/* What the output should have been mixed with */
+	memcpy(repeated_data, noise_data, sizeof(AUDIO_HEADER));
+	for (size_t i = 0; i < output_samples; i++)
+		memcpy(repeated_data + sizeof(AUDIO_HEADER) + i * sizeof(int16_t),
+		       noise_data + sizeof(AUDIO_HEADER) + (i % noise_samples) * sizeof(int16_t),
+		       sizeof(int16_t));
+
+	noise_file = noise_file_name;
+	noise_level = 10;
+	global_options |= LOOP_OPTION;
+
+	int ret = dtmf_generate(ctx.fin, ctx.fout, ctx.nsamples);
+	global_options &= ~LOOP_OPTION;
+	cr_assert((ret == 0),
+		  "Failed to write audio file in dtmf_generate (%d)", ret);
+	fflush(ctx.fout);
+
+	validate_dtmf_audio(events, nelem(events), ctx.output,
+			    ctx.expected_output_len, repeated_data,
+			    sizeof(repeated_data));
+
+	unlink(noise_file_name);
+	cleanup_test(&ctx);
+}
+
+Test(generate_suite, table_synthesis, .timeout=10)
+{
+	/* The table-driven tones must agree with direct evaluation of cos(),
+	 * including far into a long output where the phase has wrapped many times
+	 * (there the error is in cos() of the large argument, not in the table). */
+	const uint32_t starts[] = {0, 1, 7999, 8000, 123457, 2399000};
+	const size_t n = 1000;
+	double tone[n];
+
+	for (int s = 0; s < nelem(starts); s++) {
+		for (int row = 0; row < NUM_DTMF_ROW_FREQS; row++) {
+			int col = NUM_DTMF_ROW_FREQS + (row + s) % NUM_DTMF_COL_FREQS;
+			synth_tone(tone, starts[s], n, row, col);
+			for (size_t i = 0; i < n; i++) {
+				uint32_t index = starts[s] + i;
+				double a = 0.5 * cos(2.0 * M_PI * dtmf_freqs[row] * index / AUDIO_FRAME_RATE);
+				double b = 0.5 * cos(2.0 * M_PI * dtmf_freqs[col] * index / AUDIO_FRAME_RATE);
+				double expected = (a + b) * INT16_MAX;
+				cr_assert(fabs(tone[i] - expected) < 1e-3,
+					  "Synthesized sample %u for %d/%dHz differs (%lf != expected %lf)",
+					  index, dtmf_freqs[row], dtmf_freqs[col], tone[i], expected);
+			}
+		}
+	}
+}
+
+Test(generate_suite, event_parser, .timeout=10)
+{
+	char text[] = "0\t400\t5\n400\t800\t#\r\n900\t1000\tD";
+	FILE *fin = fmemopen(text, sizeof(text) - 1, "r");
+	DTMF_EVENT ev;
+
+	cr_assert_eq(events_read(fin, &ev, 0, 1000), 1, "Failed to read first event");
+	cr_assert(ev.start == 0 && ev.end == 400 && ev.symbol == '5',
+		  "Wrong first event (%u, %u, %c)", ev.start, ev.end, ev.symbol);
+	cr_assert_eq(events_read(fin, &ev, ev.end, 1000), 1, "Failed to read second event");
+	cr_assert(ev.start == 400 && ev.end == 800 && ev.symbol == '#',
+		  "Wrong second event (%u, %u, %c)", ev.start, ev.end, ev.symbol);
+	cr_assert_eq(events_read(fin, &ev, ev.end, 1000), 1, "Failed to read last event");
+	cr_assert(ev.start == 900 && ev.end == 1000 && ev.symbol == 'D',
+		  "Wrong last event (%u, %u, %c)", ev.start, ev.end, ev.symbol);
+	cr_assert_eq(events_read(fin, &ev, ev.end, 1000), 0, "Expected EOF");
+	fclose(fin);
+
+	char *bad[] = {"0\t400\tX\n", "0\t400\t5x\n", "0 400\t5\n", "400\t400\t5\n",
+		       "0\t1001\t5\n", "0\t4294967296\t5\n", "\n"};
+	for (int i = 0; i < nelem(bad); i++) {
+		fin = fmemopen(bad[i], strlen(bad[i]), "r");
+		cr_assert_eq(events_read(fin, &ev, 0, 1000), EOF,
+			     "Expected malformed event %d to be rejected", i);
+		fclose(fin);
+	}
+
+	fin = fmemopen(text, sizeof(text) - 1, "r");
+	cr_assert_eq(events_read(fin, &ev, 100, 1000), EOF,
+		     "Expected event before the end of the previous one to be rejected");
+	fclose(fin);
+}
+
+Test(generate_suite, parallel_identical, .timeout=20)
+{
+	const char *events = "100\t5000\t1\n"
+			     "60000\t70000\t#\n"
+			     "131000\t131072\tD\n"
+			     "131072\t140000\t5\n";
+	const uint32_t length = 20 * AUDIO_FRAME_RATE;
+	const size_t len = sizeof(AUDIO_HEADER) + length * sizeof(int16_t);
+	char *noise_file_name = "randnoise5.au";
+	char noise_data[sizeof(AUDIO_HEADER) + 300 * AUDIO_FRAME_RATE / 1000 * sizeof(int16_t)];
+	/* One more byte for the null that fmemopen() writes at the end */
+	char *serial = malloc(len + 1), *parallel = malloc(len);
+	cr_assert(serial && parallel, "Cannot malloc output buffers");
+
+	generate_noise_file(noise_file_name, noise_data, 300);
+	noise_file = noise_file_name;
+	noise_level = 5;
+	global_options = GENERATE_OPTION | LOOP_OPTION;
+
+	/* Serial, into memory */
+	FILE *in = fmemopen((char *)events, strlen(events), "r");
+	FILE *out = fmemopen(serial, len + 1, "w");
+	generate_threads = 0;
+	cr_assert_eq(dtmf_generate(in, out, length), 0, "Serial generation failed");
+	fclose(out);
+	fclose(in);
+
+	/* Parallel, into a regular file spanning several segments */
+	in = fmemopen((char *)events, strlen(events), "r");
+	out = tmpfile();
+	generate_threads = 4;
+	int ret = dtmf_generate(in, out, length);
+	generate_threads = 0;
+	global_options = 0;
+	noise_file = NULL;
+	cr_assert_eq(ret, 0, "Parallel generation failed");
+	cr_assert_eq(ftell(out), (long)len, "Output left at %ld, expected %zu", ftell(out), len);
+	rewind(out);
+	cr_assert_eq(fread(parallel, 1, len, out), len, "Parallel output is short");
+	cr_assert_eq(fgetc(out), EOF, "Parallel output is long");
+	fclose(out);
+	fclose(in);
+	unlink(noise_file_name);
+
+	cr_assert(!memcmp(serial, parallel, len), "Parallel output differs from serial output");
+	free(serial);
+	free(parallel);
+}
@@ -0,0 +1,159 @@
+#include "test_common.h"
+#include "goertzel.h"
+#include "goertzel_fixed.h"
+
+/*
+ * The fixed-point filters are accepted if their strengths agree with the
+ * reference double-precision ones to within this relative error, plus an
+ * absolute error that is far below the .01 power floor used by the detector.
+ */
+static const double rel_epsilon = 1e-3;
+static const double abs_epsilon = 1e-7;
+
+static void compare_strengths(char *audio, size_t audiolen, int block_size)
+{
+	int16_t *samples = (int16_t *)(audio + sizeof(AUDIO_HEADER));
+	size_t nsamples = (audiolen - sizeof(AUDIO_HEADER)) / sizeof(int16_t);
+	GOERTZEL_STATE ref[NUM_DTMF_FREQS];
+	GOERTZEL_FIXED_STATE fixed[NUM_DTMF_FREQS];
+
+	for (size_t base = 0; base + block_size <= nsamples; base += block_size) {
+		for (int f = 0; f < NUM_DTMF_FREQS; f++) {
+			double k = ((double)dtmf_freqs[f] * block_size) / AUDIO_FRAME_RATE;
+			ref_goertzel_init(&ref[f], block_size, k);
+			goertzel_fixed_init(&fixed[f], block_size, k);
+		}
+		for (int i = 0; i < block_size; i++) {
+			uint8_t *bytes = (uint8_t *)&samples[base + i];
+			int16_t sample = (bytes[0] << 8) | bytes[1];
+			double x = ((double)sample) / INT16_MAX;
+			for (int f = 0; f < NUM_DTMF_FREQS; f++) {
+				if (i < block_size - 1) {
+					ref_goertzel_step(&ref[f], x);
+					goertzel_fixed_step(&fixed[f], sample);
+					continue;
+				}
+				double expected = ref_goertzel_strength(&ref[f], x);
+				double got = goertzel_fixed_strength(&fixed[f], sample);
+				cr_assert(fabs(got - expected) <= rel_epsilon * expected + abs_epsilon,
+					  "Fixed-point strength for %dHz at sample %zu with N=%d "
+					  "(%.12f != expected value %.12f)",
+					  dtmf_freqs[f], base, block_size, got, expected);
+			}
+		}
+	}
+}
+
+static void check_block_sizes(struct _dtmf_event *events, int n, int duration,
+			      bool has_noise, int level)
+{
+	size_t audiolen = sizeof(AUDIO_HEADER) + duration * AUDIO_FRAME_RATE / 1000 * sizeof(int16_t);
+	char *audio = malloc(audiolen);
+	char *noise = NULL;
+	cr_assert(audio != NULL, "Cannot malloc audio buffer");
+	if (has_noise) {
+		noise = malloc(audiolen);
+		cr_assert(noise != NULL, "Cannot malloc noise buffer");
+		generate_noise(noise, duration);
+	}
+	generate_dtmf_audio(events, n, audio, audiolen, noise, audiolen, level);
+
+	const int block_sizes[] = {10, 50, 100, 205, 500, 1000};
+	for (int b = 0; b < nelem(block_sizes); b++)
+		compare_strengths(audio, audiolen, block_sizes[b]);
+
+	free(audio);
+	free(noise);
+}
+
+Test(goertzel_fixed_suite, strength_clean, .timeout=10)
+{
+	struct _dtmf_event events[] = {{0, 1000, '1'}, {1000, 2000, '5'},
+				       {2500, 3000, '9'}, {3000, 4000, 'D'},
+				       {4500, 6000, '*'}, {6000, 7000, '#'}};
+	check_block_sizes(events, nelem(events), 1000, false, 0);
+}
+
+Test(goertzel_fixed_suite, strength_noisy, .timeout=10)
+{
+	struct _dtmf_event events[] = {{0, 2000, '0'}, {4000, 6000, 'A'},
+				       {7000, 8000, '7'}};
+	check_block_sizes(events, nelem(events), 1000, true, 10);
+}
+
+Test(goertzel_fixed_suite, strength_full_scale, .timeout=10)
+{
+	/* Full-scale noise with no tones drives the filter state the hardest */
+	check_block_sizes(NULL, 0, 1000, true, 30);
+}
+
+Test(goertzel_fixed_suite, detect_matches_double, .timeout=10)
+{
+	struct _dtmf_event events[] = {
+	    {0, 500, '4'},     {1500, 2000, '5'}, {2000, 2400, 'C'},
+	    {2500, 3000, 'D'}, {4000, 7000, '#'}, {7500, 8000, '1'},
+	    {9000, 10000, '0'}};
+	const int duration = 1500;
+	size_t audiolen = sizeof(AUDIO_HEADER) + duration * AUDIO_FRAME_RATE / 1000 * sizeof(int16_t);
+	char *audio = malloc(audiolen);
+	char *noise = malloc(audiolen);
+	cr_assert(audio != NULL && noise != NULL, "Cannot malloc audio buffers");
+	generate_noise(noise, duration);
+	generate_dtmf_audio(events, nelem(events), audio, audiolen, noise, audiolen, -5);
+
+	const int block_sizes[] = {50, 100, 205, 600};
+	for (int b = 0; b < nelem(block_sizes); b++) {
+		char expected[4096] = {0};
+		char got[4096] = {0};
+		block_size = block_sizes[b];
+
+		FILE *in = fmemopen(audio, audiolen, "r");
+		FILE *out = fmemopen(expected, sizeof(expected), "w");
+		global_options = DETECT_OPTION;
+		dtmf_detect(in, out);
+		fclose(in);
+		fclose(out);
+
+		in = fmemopen(audio, audiolen, "r");
+		out = fmemopen(got, sizeof(got), "w");
+		global_options = DETECT_OPTION | FIXED_OPTION;
+		dtmf_detect(in, out);
+		fclose(in);
+		fclose(out);
+
+		cr_assert(!strcmp(got, expected),
+			  "Fixed-point detection differs for block size %d.\n"
+			  "Expected:\n%s\nGot:\n%s\n", block_size, expected, got);
+	}
+	free(audio);
+	free(noise);
+}
+
+Test(goertzel_fixed_suite, coefficient_near_zero_frequency, .timeout=10)
+{
+	/* 2 cos(A) rounds to 2 for k = 0, which is just outside Q2.30 */
+	GOERTZEL_FIXED_STATE fixed;
+	GOERTZEL_STATE ref;
+	const int N = 100;
+	goertzel_fixed_init(&fixed, N, 0);
+	cr_assert_eq(fixed.B, INT32_MAX, "B for k = 0 is %d, not clamped to %d",
+		     fixed.B, INT32_MAX);
+	goertzel_fixed_init(&fixed, N, 1e-4);
+	cr_assert_eq(fixed.B, INT32_MAX, "B for k = 1e-4 is %d, not clamped to %d",
+		     fixed.B, INT32_MAX);
+
+	/* a constant signal then stays at the frequency, instead of diverging */
+	goertzel_fixed_init(&fixed, N, 0);
+	ref_goertzel_init(&ref, N, 0);
+	int16_t sample = INT16_MAX / 2;
+	double x = ((double)sample) / INT16_MAX;
+	for (int i = 0; i < N - 1; i++) {
+		goertzel_fixed_step(&fixed, sample);
+		ref_goertzel_step(&ref, x);
+	}
+	double expected = ref_goertzel_strength(&ref, x);
+	double got = goertzel_fixed_strength(&fixed, sample);
+	cr_assert(fabs(got - expected) <= rel_epsilon * expected + abs_epsilon,
+		  "Fixed-point strength at k = 0 (%.12f != expected value %.12f)",
+		  got, expected);
+}
@@ -0,0 +1,156 @@
+#include <pthread.h>
+
+#include "test_common.h"
+#include "source.h"
+#include "detector.h"
+#include "checkpoint.h"
+
+/*
+ * Read a whole source into out, checking that every chunk but the last is
+ * full, and return the number of bytes read.
+ */
+static size_t drain_source(SAMPLE_SOURCE *sp, uint8_t *out)
+{
+	size_t total = 0;
+	while (1) {
+		const uint8_t *pcm;
+		size_t got = source_read(sp, &pcm);
+		cr_assert(got <= sp->chunk, "Source returned %zu frames, more than %zu",
+			  got, sp->chunk);
+		memcpy(out + total, pcm, got * sp->frame);
+		total += got * sp->frame;
+		if (got < sp->chunk)
+			break;
+	}
+	cr_assert_eq(source_read(sp, NULL), 0, "Source returned data after its end");
+	return total;
+}
+
+Test(source_suite, memory_chunks, .timeout=10)
+{
+	uint8_t data[1001], out[1001];
+	for (int i = 0; i < nelem(data); i++)
+		data[i] = i * 7;
+
+	/* Stereo frames of four bytes, 16 to a chunk; the last byte is dropped */
+	SAMPLE_SOURCE src;
+	source_open_memory(&src, data, sizeof(data), 4, 16);
+	size_t total = drain_source(&src, out);
+	cr_assert_eq(source_close(&src), 0, "Memory source reported an error");
+	cr_assert_eq(total, 1000, "Read %zu bytes, expected 1000", total);
+	cr_assert(!memcmp(data, out, total), "Data differs from what was given");
+}
+
+struct pipe_writer {
+	int fd;
+	const uint8_t *data;
+	size_t len;
+};
+
+/* Write the data to the pipe in small uneven pieces, then close it */
+static void *write_pipe(void *arg)
+{
+	struct pipe_writer *pw = arg;
+	size_t off = 0, piece = 1;
+	while (off < pw->len) {
+		size_t n = piece < pw->len - off ? piece : pw->len - off;
+		off += write(pw->fd, pw->data + off, n);
+		piece = piece * 5 % 997 + 1;
+	}
+	close(pw->fd);
+	return NULL;
+}
+
+Test(source_suite, readahead_pipe, .timeout=10)
+{
+	static uint8_t data[100000], out[100000];
+	for (int i = 0; i < nelem(data); i++)
+		data[i] = i * 13 + (i >> 8);
+
+	int fds[2];
+	cr_assert_eq(pipe(fds), 0, "Cannot create pipe");
+	struct pipe_writer pw = {fds[1], data, sizeof(data)};
+	pthread_t writer;
+	pthread_create(&writer, NULL, write_pipe, &pw);
+
+	FILE *in = fdopen(fds[0], "r");
+	SAMPLE_SOURCE src;
+	cr_assert_eq(source_open(&src, in, 2, 1000), 0, "Cannot open source over pipe");
+	cr_assert(src.data != NULL, "A pipe was not given the read-ahead source");
+	size_t total = drain_source(&src, out);
+	cr_assert_eq(source_close(&src), 0, "Read-ahead source reported an error");
+	pthread_join(writer, NULL);
+	fclose(in);
+
+	cr_assert_eq(total, sizeof(data), "Read %zu bytes, expected %zu", total, sizeof(data));
+	cr_assert(!memcmp(data, out, total), "Data differs from what was written");
+}
+
+Test(source_suite, detector_over_memory, .timeout=10)
+{
+	struct _dtmf_event events[] = {{0, 1000, '0'}, {1000, 2000, '1'}, {4000, 6000, '#'}};
+	const int duration_ms = 1000;
+	size_t len = sizeof(AUDIO_HEADER) + duration_ms * AUDIO_FRAME_RATE / 1000 * sizeof(int16_t);
+	char audio[len];
+	generate_dtmf_audio(events, nelem(events), audio, len, NULL, 0, 0);
+
+	char output[4096] = {0};
+	FILE *fout = fmemopen(output, sizeof(output), "w");
+	DTMF_DETECTOR detector;
+	detector_init(&detector, 100, AUDIO_FRAME_RATE, NULL, fout);
+	SAMPLE_SOURCE src;
+	source_open_memory(&src, audio + sizeof(AUDIO_HEADER), len - sizeof(AUDIO_HEADER),
+			   AUDIO_BYTES_PER_SAMPLE, 333);
+	int ret = detector_run_source(&detector, 1, &src);
+	source_close(&src);
+	fclose(fout);
+
+	const char *expected = "0\t1000\t0\n1000\t2000\t1\n4000\t6000\t#\n";
+	cr_assert_eq(ret, 0, "detector_run_source failed");
+	cr_assert(!strcmp(output, expected),
+		  "Events differ from given ones.\n"
+		  "Output text is:\n%s\n",
+		  output);
+}
+
+Test(source_suite, checkpoint_resume, .timeout=10)
+{
+	struct _dtmf_event events[] = {{0, 1000, '0'}, {1000, 2000, '1'}, {4000, 6000, '#'}};
+	const int duration_ms = 1000;
+	size_t len = sizeof(AUDIO_HEADER) + duration_ms * AUDIO_FRAME_RATE / 1000 * sizeof(int16_t);
+	char audio[len];
+	generate_dtmf_audio(events, nelem(events), audio, len, NULL, 0, 0);
+	const uint8_t *pcm = (uint8_t *)audio + sizeof(AUDIO_HEADER);
+
+	/* Stop in the middle of a block of the '#' event, checkpoint, and
+	 * carry on in a fresh detector restored from the checkpoint */
+	const size_t split = 4321;
+	char output[4096] = {0};
+	FILE *fout = fmemopen(output, sizeof(output), "w");
+	FILE *ck = tmpfile();
+	DTMF_DETECTOR first, second;
+	detector_init(&first, 100, AUDIO_FRAME_RATE, NULL, fout);
+	detector_feed(&first, pcm, split);
+	cr_assert_eq(detector_checkpoint(&first, 1, ck), 0, "detector_checkpoint failed");
+
+	rewind(ck);
+	detector_init(&second, 100, AUDIO_FRAME_RATE, NULL, fout);
+	cr_assert_eq(detector_restore(&second, 1, ck), 0, "detector_restore failed");
+	detector_feed(&second, pcm + split * 2, AUDIO_FRAME_RATE - split);
+	detector_finish(&second);
+	fclose(fout);
+
+	const char *expected = "0\t1000\t0\n1000\t2000\t1\n4000\t6000\t#\n";
+	cr_assert(!strcmp(output, expected),
+		  "Events differ from given ones.\n"
+		  "Output text is:\n%s\n",
+		  output);
+
+	/* A checkpoint is refused by detectors that are set up differently */
+	DTMF_DETECTOR other;
+	detector_init(&other, 205, AUDIO_FRAME_RATE, NULL, stdout);
+	rewind(ck);
+	cr_assert_eq(detector_restore(&other, 1, ck), EOF,
+		     "Checkpoint was restored with a different block size");
+	fclose(ck);
+}
@@ -2,6 +2,7 @@
 #include <criterion/logging.h>
 #include <string.h>
 #include "const.h"
+#include "detector.h"
 
 #define FLAG_BITS 0x7
 
@@ -126,6 +127,123 @@ Test(validargs_suite, dtmf_d_b_bsize, .timeout=10) {
 		 bsize_exp, block_size);
 }
 
+/* bin/dtmf -d -s -b bsize_str */
+Test(validargs_suite, dtmf_d_s_b_bsize, .timeout=10) {
+    char *bsize_str = "200";
+    int bsize_exp = atoi(bsize_str);
+    char *argv[] = {"bin/dtmf", "-d", "-s", "-b", bsize_str, NULL};
+    int argc = sizeof(argv)/sizeof(char *) - 1;
+    int ret = validargs(argc, argv);
+    int exp_ret = 0;
+    int flag = 0x4;
+    cr_assert_eq(ret, exp_ret, "Invalid return for validargs.  Got: %d | Expected: %d",
+		 ret, exp_ret);
+    cr_assert_eq(global_options & FLAG_BITS, flag, "Correct bit (0x%x) not set for -d. Got: %x",
+		 flag, global_options);
+    cr_assert(global_options & STREAM_OPTION, "Stream bit not set for -s. Got: %x",
+		 global_options);
+    cr_assert_eq(bsize_exp, block_size, "Correct block_size (%d) not set for -b. Got: %d",
+		 bsize_exp, block_size);
+}
+
+/* bin/dtmf -g -j 8 -r */
+Test(validargs_suite, dtmf_g_j_threads_r, .timeout=10) {
+    char *argv[] = {"bin/dtmf", "-g", "-j", "8", "-r", NULL};
+    int argc = sizeof(argv)/sizeof(char *) - 1;
+    int ret = validargs(argc, argv);
+    int exp_ret = 0;
+    int flag = 0x2;
+    cr_assert_eq(ret, exp_ret, "Invalid return for validargs.  Got: %d | Expected: %d",
+		 ret, exp_ret);
+    cr_assert_eq(global_options & FLAG_BITS, flag, "Correct bit (0x%x) not set for -g. Got: %x",
+		 flag, global_options);
+    cr_assert_eq(generate_threads, 8, "Correct generate_threads (8) not set for -j. Got: %d",
+		 generate_threads);
+}
+
+/* bin/dtmf -d -a -q */
+Test(validargs_suite, dtmf_d_a_q, .timeout=10) {
+    char *argv[] = {"bin/dtmf", "-d", "-a", "-q", NULL};
+    int argc = sizeof(argv)/sizeof(char *) - 1;
+    int ret = validargs(argc, argv);
+    int exp_ret = 0;
+    int flag = 0x4;
+    cr_assert_eq(ret, exp_ret, "Invalid return for validargs.  Got: %d | Expected: %d",
+		 ret, exp_ret);
+    cr_assert_eq(global_options & FLAG_BITS, flag, "Correct bit (0x%x) not set for -d. Got: %x",
+		 flag, global_options);
+    cr_assert(global_options & ADAPTIVE_OPTION, "Adaptive bit not set for -a. Got: %x",
+		 global_options);
+    cr_assert(global_options & FIXED_OPTION, "Fixed-point bit not set for -q. Got: %x",
+		 global_options);
+}
+
+/* bin/dtmf -d -O summary -B recordings, and the combinations that are not allowed */
+Test(validargs_suite, dtmf_d_O_format, .timeout=10) {
+    char *ok[] = {"bin/dtmf", "-d", "-O", "summary", "-B", "recordings", NULL};
+    char *bad_format[] = {"bin/dtmf", "-d", "-O", "xml", NULL};
+    char *binary_batch[] = {"bin/dtmf", "-d", "-O", "binary", "-B", "recordings", NULL};
+    char *summary_stream[] = {"bin/dtmf", "-d", "-s", "-O", "summary", NULL};
+    int ret = validargs(sizeof(ok)/sizeof(char *) - 1, ok);
+    cr_assert_eq(ret, 0, "Invalid return for validargs.  Got: %d | Expected: 0", ret);
+    cr_assert_eq(output_format, DETECT_FORMAT_SUMMARY,
+		 "Correct output_format (%d) not set for -O. Got: %d",
+		 DETECT_FORMAT_SUMMARY, output_format);
+    output_format = DETECT_FORMAT_TEXT;
+    cr_assert_eq(validargs(sizeof(bad_format)/sizeof(char *) - 1, bad_format), -1,
+		 "Unknown format was accepted");
+    cr_assert_eq(validargs(sizeof(binary_batch)/sizeof(char *) - 1, binary_batch), -1,
+		 "Binary format was accepted with -B");
+    cr_assert_eq(validargs(sizeof(summary_stream)/sizeof(char *) - 1, summary_stream), -1,
+		 "Summary format was accepted with -s");
+}
+
+/* bin/dtmf -d -C scan.ckpt */
+Test(validargs_suite, dtmf_d_C_checkpoint, .timeout=10) {
+    char *ok[] = {"bin/dtmf", "-d", "-C", "scan.ckpt", NULL};
+    char *batch[] = {"bin/dtmf", "-d", "-C", "scan.ckpt", "-B", "recordings", NULL};
+    char *generate[] = {"bin/dtmf", "-g", "-C", "scan.ckpt", NULL};
+    int ret = validargs(sizeof(ok)/sizeof(char *) - 1, ok);
+    cr_assert_eq(ret, 0, "Invalid return for validargs.  Got: %d | Expected: 0", ret);
+    cr_assert(checkpoint_file != NULL && !strcmp(checkpoint_file, "scan.ckpt"),
+	      "Checkpoint file not set for -C. Got: %s", checkpoint_file);
+    checkpoint_file = NULL;
+    cr_assert_eq(validargs(sizeof(batch)/sizeof(char *) - 1, batch), -1,
+		 "Checkpoint file was accepted with -B");
+    checkpoint_file = NULL;
+    cr_assert_eq(validargs(sizeof(generate)/sizeof(char *) - 1, generate), -1,
+		 "Checkpoint file was accepted with -g");
+}
+
+/* bin/dtmf -d -B recordings -j 4 */
+Test(validargs_suite, dtmf_d_B_list_j_threads, .timeout=10) {
+    char *list_exp = "recordings";
+    char *argv[] = {"bin/dtmf", "-d", "-B", list_exp, "-j", "4", NULL};
+    int argc = sizeof(argv)/sizeof(char *) - 1;
+    int ret = validargs(argc, argv);
+    int exp_ret = 0;
+    int flag = 0x4;
+    cr_assert_eq(ret, exp_ret, "Invalid return for validargs.  Got: %d | Expected: %d",
+		 ret, exp_ret);
+    cr_assert_eq(global_options & FLAG_BITS, flag, "Correct bit (0x%x) not set for -d. Got: %x",
+		 flag, global_options);
+    cr_assert(batch_list && !strcmp(batch_list, list_exp),
+	      "Variable 'batch_list' was not properly set.  Got: %s | Expected: %s",
+	      batch_list, list_exp);
+    cr_assert_eq(batch_threads, 4, "Correct batch_threads (4) not set for -j. Got: %d",
+		 batch_threads);
+}
+
+/* bin/dtmf -d -s -B recordings */
+Test(validargs_suite, dtmf_d_s_B_list, .timeout=10) {
+    char *argv[] = {"bin/dtmf", "-d", "-s", "-B", "recordings", NULL};
+    int argc = sizeof(argv)/sizeof(char *) - 1;
+    int ret = validargs(argc, argv);
+    int exp_ret = -1;
+    cr_assert_eq(ret, exp_ret, "Invalid return for validargs.  Got: %d | Expected: %d",
+		 ret, exp_ret);
+}
+
 /* bin/dtmf -d -b -1 */
 Test(validargs_suite, dtmf_d_b_invalidBSize, .timeout=10) {
     char* bsize_str = "-1";
@@ -0,0 +1,151 @@
+/*
+ * Latency of sf_malloc and sf_free, in the default mode and in TLSF mode.
+ *
+ *   make bench && bin/sfmm_bench [ROUNDS]
+ *
+ * The heap is first grown to nearly its limit, so that no call below grows it.
+ * Then one of two workloads is run:
+ *
+ *   random  ROUNDS times (default 200000), a random one of BENCH_SLOTS slots
+ *           is freed if it holds a block, or given a block of a random size
+ *           between BENCH_MIN_SIZE and BENCH_MAX_SIZE bytes if not.  The sizes
+ *           are above those of the quick lists, so every call goes through the
+ *           free lists.
+ *   holes   BENCH_HOLES free blocks of BENCH_HOLE_SIZE bytes are left between
+ *           allocated ones, then ROUNDS times a block of BENCH_MAX_SIZE bytes,
+ *           which is of the same class but does not fit in a hole, is
+ *           allocated and freed.  First fit looks at every hole each time.
+ *
+ * Each call is timed on its own, and one tab-separated line is printed per
+ * workload, mode and function:
+ *
+ *   workload  mode  function  calls  failed  mean_ns  p99_ns  p999_ns  max_ns
+ *
+ * failed counts the calls to sf_malloc that returned NULL because no free
+ * block was large enough.  Since the allocator has no way to start over with
+ * a fresh heap, each mode is run in a child process of its own.
+ *
+ * The maximum of any run includes the odd interrupt or page fault; it is the
+ * high percentiles, and how they change with the number of free blocks, that
+ * tell the bounded searches apart from the unbounded ones.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "sfmm.h"
+#include "sfmm_ext.h"
+
+#define BENCH_SLOTS 256
+#define BENCH_MIN_SIZE 200
+#define BENCH_MAX_SIZE 1000
+#define BENCH_HOLES 140
+#define BENCH_HOLE_SIZE 700
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static int compare_long(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char *workload, const char *mode, const char *function,
+                   long *times, long calls, long failed) {
+    if (calls == 0) {
+        return;
+    }
+    long sum = 0;
+    for (long i = 0; i < calls; i++) {
+        sum += times[i];
+    }
+    qsort(times, calls, sizeof(*times), compare_long);
+    printf("%s\t%s\t%s\t%ld\t%ld\t%.1f\t%ld\t%ld\t%ld\n", workload, mode, function, calls, failed,
+           (double)sum / calls, times[calls * 99 / 100], times[calls * 999 / 1000], times[calls - 1]);
+}
+
+static void run(const char *workload, const char *mode, long rounds) {
+    // grow the heap once, leaving a page for its prologue and epilogue.
+    sf_free(sf_malloc(PAGE_SZ * 19));
+
+    long *malloc_times = malloc(rounds * sizeof(long));
+    long *free_times = malloc(rounds * sizeof(long));
+    long mallocs = 0, frees = 0, failed = 0;
+    if (workload[0] == 'h') {
+        void *holes[BENCH_HOLES];
+        for (int i = 0; i < BENCH_HOLES; i++) {
+            holes[i] = sf_malloc(BENCH_HOLE_SIZE);
+            sf_malloc(1);
+        }
+        for (int i = 0; i < BENCH_HOLES; i++) {
+            sf_free(holes[i]);
+        }
+        for (long round = 0; round < rounds; round++) {
+            long start = now_ns();
+            void *block = sf_malloc(BENCH_MAX_SIZE);
+            malloc_times[mallocs++] = now_ns() - start;
+            failed += block == NULL;
+            start = now_ns();
+            sf_free(block);
+            free_times[frees++] = now_ns() - start;
+        }
+        report(workload, mode, "malloc", malloc_times, mallocs, failed);
+        report(workload, mode, "free", free_times, frees, 0);
+        free(malloc_times);
+        free(free_times);
+        return;
+    }
+
+    void *slots[BENCH_SLOTS] = {0};
+    unsigned int seed = 1;
+    for (long round = 0; round < rounds; round++) {
+        seed = seed * 1103515245 + 12345;
+        int slot = (seed >> 16) % BENCH_SLOTS;
+        if (slots[slot] != NULL) {
+            long start = now_ns();
+            sf_free(slots[slot]);
+            free_times[frees++] = now_ns() - start;
+            slots[slot] = NULL;
+        } else {
+            seed = seed * 1103515245 + 12345;
+            size_t size = BENCH_MIN_SIZE + (seed >> 8) % (BENCH_MAX_SIZE - BENCH_MIN_SIZE + 1);
+            long start = now_ns();
+            slots[slot] = sf_malloc(size);
+            malloc_times[mallocs++] = now_ns() - start;
+            failed += slots[slot] == NULL;
+        }
+    }
+    report(workload, mode, "malloc", malloc_times, mallocs, failed);
+    report(workload, mode, "free", free_times, frees, 0);
+    free(malloc_times);
+    free(free_times);
+}
+
+int main(int argc, char **argv) {
+    long rounds = argc > 1 ? atol(argv[1]) : 200000;
+    printf("workload\tmode\tfunction\tcalls\tfailed\tmean_ns\tp99_ns\tp999_ns\tmax_ns\n");
+    fflush(stdout);
+    const char *workloads[] = {"random", "holes"};
+    for (int w = 0; w < 2; w++) {
+        for (int tlsf = 0; tlsf <= 1; tlsf++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                sf_set_tlsf(tlsf);
+                run(workloads[w], tlsf ? "tlsf" : "default", rounds);
+                fflush(stdout);
+                _exit(0);
+            }
+            int status;
+            if (pid == -1 || waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                fprintf(stderr, "The %s %s run failed\n", workloads[w], tlsf ? "tlsf" : "default");
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
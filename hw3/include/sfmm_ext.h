@@ -0,0 +1,109 @@
+/**
+ * Extensions to the allocator interface of sfmm.h, which may not be changed.
+ *
+ * Everything here is opt-in: until one of these functions is called the
+ * allocator behaves exactly as described in sfmm.h.
+ */
+#ifndef SFMM_EXT_H
+#define SFMM_EXT_H
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Thread-safe mode.
+ *
+ * In this mode sf_malloc, sf_free and sf_realloc may be called from any number of threads.
+ * The heap, its free lists and quick lists are shared and protected by a single lock.
+ * In front of them every thread keeps a cache of free blocks for each quick list size class,
+ * holding up to THREAD_CACHE_MAX blocks per class.  Allocating a block of a cached size
+ * and freeing one into a cache that is not full touch only the thread's own cache and the
+ * block's own header, and take no lock.  An empty cache is refilled, and a full one flushed,
+ * THREAD_CACHE_BATCH blocks at a time under the lock.  Blocks in a cache stay marked as
+ * allocated, so they are never coalesced, and their headers are not changed: which blocks are
+ * cached is known only to the cache, since other threads may be updating the bit of a cached
+ * block's header that tells whether the block before it is allocated.  The cache of a thread
+ * is flushed back to the heap when the thread exits.
+ *
+ * In thread-safe mode sf_free checks only the header of a block of a cached size, not the footer
+ * of the block before it, since that may be changing under the lock in another thread; freeing
+ * a block that is already in the calling thread's cache is caught by looking for it there.
+ */
+#define THREAD_CACHE_MAX   16  /* Maximum number of blocks in one class of a thread cache. */
+#define THREAD_CACHE_BATCH  8  /* Number of blocks moved by one refill or flush. */
+
+/*
+ * Turn thread-safe mode on or off.  It must be turned on before a second thread uses the
+ * allocator, and only turned off when no other thread is using it.  Turning it off flushes
+ * the cache of the calling thread.
+ *
+ * @param enable  true to turn thread-safe mode on, false to turn it off.
+ */
+void sf_set_thread_safe(bool enable);
+
+/*
+ * Two-level segregated fit (TLSF) mode.
+ *
+ * In this mode the free blocks are kept, instead of in the ten power-of-two classes of
+ * sf_free_list_heads, in a two-level array of lists: a first level for each power of two,
+ * each divided linearly into 16 second-level lists.  A bitmap of the non-empty first-level
+ * classes and one of the non-empty lists of each class find, with two bit scans, the first
+ * non-empty list whose blocks are all large enough, and the first block in it is used; only if
+ * there is none is the first block of the list of the request itself tried.
+ * Allocation from the free lists and freeing therefore take constant time, whatever the
+ * number of free blocks, and the block chosen is never more than 1/16 larger than the
+ * smallest list that can satisfy the request.  The quick lists are used as usual.
+ *
+ * sf_free_list_heads stays empty in this mode.
+ *
+ * Only a heap that has not been used yet can change mode.
+ *
+ * @param enable  true to turn TLSF mode on, false to turn it off.
+ * @return 0 on success, -1 if the heap is already in use.
+ */
+int sf_set_tlsf(bool enable);
+
+/*
+ * Heap growth policy.
+ *
+ * When no free block is large enough, the heap grows, in one go, by the number of pages that
+ * the block needs at the end of the heap, where they are coalesced with the free block that may
+ * already be there.  With a growth percentage set, it grows by at least that percentage of its
+ * current size instead, rounded up to whole pages, so that a heap that keeps growing does so
+ * in fewer and fewer steps.  The pages beyond those needed are only taken while the heap is
+ * below its limit.
+ *
+ * @param percent  the growth percentage; 0, the default, grows by only the pages needed.
+ */
+void sf_set_heap_growth(unsigned int percent);
+
+/*
+ * Large objects.
+ *
+ * With a threshold set, sf_malloc serves every request of at least that many bytes from a
+ * mapping of its own, outside the heap, and records it in a table of up to 768 large objects
+ * (beyond that, requests come from the heap as usual).  sf_free unmaps a large object at once,
+ * returning its memory to the system, and sf_realloc resizes its mapping, which the system does
+ * in place when it can and otherwise by moving the pages rather than copying them.  A large object
+ * resized below the threshold moves into the heap, and a heap block resized to the threshold or
+ * beyond moves out of it.  Large objects are not part of the heap, so they are left out of
+ * sf_utilization, and are not limited by the size of the heap.
+ *
+ * @param size  the threshold in bytes; 0, the default, maps no request on its own.
+ */
+void sf_set_large_threshold(size_t size);
+
+/*
+ * In-place growth in sf_realloc.
+ *
+ * By default sf_realloc grows a block by allocating a new one, copying the payload and freeing
+ * the old block.  In this mode it first tries to grow the block where it is: if the block after
+ * it is free and large enough, that block is taken out of its free list and joined to it, with
+ * whatever is not needed split off again as a free block; if the block is at the end of the heap
+ * (or followed by a free block that is), the heap is grown first.  Only when neither works is the
+ * payload copied.
+ *
+ * @param enable  true to grow blocks in place when possible, false to always copy.
+ */
+void sf_set_realloc_in_place(bool enable);
+
+#endif
@@ -2,12 +2,18 @@
  * Do not submit your assignment with a main function in this file.
  * If you submit with a main function in this file, you will get a zero.
  */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "debug.h"
 #include "sfmm.h"
+#include "sfmm_ext.h"
 
 // header is 8 bytes.
 #define BOUNDRY_TAG_SIZE 8
@@ -19,9 +25,64 @@
 #define MAX_QUICK_LIST_BLOCK_SIZE 32 + (NUM_QUICK_LISTS - 1) * ALLIGNMENT
 // lower 4 bits on
 #define BINARY_LOWER_FOUR_ON 0xf
+// TLSF mode: second level lists per power of two, and log2 of the size of the first level 0.
+#define TLSF_SL_LOG2 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_FL_SHIFT 5
+// first level lists, for sizes [2^5, 2^32).
+#define TLSF_FL_COUNT 27
+// slots of the table of large objects (a power of two), and how many of them may be used.
+#define LARGE_TABLE_SIZE 1024
+#define LARGE_MAX_OBJECTS (LARGE_TABLE_SIZE / 4 * 3)
 
 size_t real_heap_usage = 0, max = 0;
 
+// bit i is on when sf_free_list_heads[i] is not empty.
+static unsigned int free_list_bitmap = 0;
+
+// TLSF mode: whether it is on, its lists (used instead of sf_free_list_heads), and their bitmaps.
+static bool tlsf = false;
+static sf_block tlsf_heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+static unsigned int tlsf_fl_bitmap = 0;
+static unsigned int tlsf_sl_bitmap[TLSF_FL_COUNT];
+
+// large objects: the size from which requests are mapped on their own (0: never), and the table
+// of the mappings, open addressing with linear probing on their address.
+typedef struct large_object {
+    void *address;
+    size_t length;
+} large_object;
+static size_t large_threshold = 0;
+static large_object large_table[LARGE_TABLE_SIZE];
+// updated under heap_lock, but atomic since the lock-free path of sf_free reads it.
+static size_t large_count = 0;
+
+// whether sf_realloc grows a block in place when it can.
+static bool realloc_in_place = false;
+
+// percentage of the heap size by which it grows at least when it has to grow (0: only what is needed).
+static unsigned int heap_growth = 0;
+
+// thread-safe mode: whether it is on, the lock on the shared heap, and the cache of each thread.
+static bool thread_safe = false;
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t thread_cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_cache_key;
+// the bounds of the heap, stored under heap_lock each time it grows, for the lock-free path of
+// sf_free that cannot call sf_mem_start and sf_mem_end while another thread grows the heap.
+static void *heap_start = NULL;
+static void *heap_end = NULL;
+
+typedef struct thread_cache {
+    struct {
+        int length;             // Number of blocks currently in the list.
+        struct sf_block *first; // Pointer to first block in the list.
+    } lists[NUM_QUICK_LISTS];
+    char registered;            // 1 once the cache is to be flushed when the thread exits.
+} thread_cache;
+
+static __thread thread_cache local_cache;
+
 // --------------------------- START OF HELPER FUNCTIONS --------------------------- //
 
 /**
@@ -36,6 +97,39 @@ static size_t xor_magic(size_t number) {
     return number ^ MAGIC;
 }
 
+/**
+ * @brief Add to the payload in use and update the peak, atomically since in thread-safe mode the
+ * thread caches do this without the lock.
+ *
+ * @param payload
+ *      the payload size of the block that is now in use.
+ */
+static void add_heap_usage(size_t payload) {
+    size_t now = __atomic_add_fetch(&real_heap_usage, payload, __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&max, __ATOMIC_RELAXED);
+    while (now > peak && !__atomic_compare_exchange_n(&max, &peak, now, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * @brief Subtract from the payload in use, atomically (see add_heap_usage).
+ *
+ * @param payload
+ *      the payload size of the block that is no longer in use.
+ */
+static void sub_heap_usage(size_t payload) {
+    __atomic_sub_fetch(&real_heap_usage, payload, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Publish the bounds of the heap once it has grown and its new epilogue is in place
+ * (the caller holds heap_lock in thread-safe mode).
+ */
+static void update_heap_bounds(void) {
+    __atomic_store_n(&heap_start, sf_mem_start(), __ATOMIC_RELEASE);
+    __atomic_store_n(&heap_end, sf_mem_end(), __ATOMIC_RELEASE);
+}
+
 /**
  * @brief round up to the nearest multiple of ALLIGNMENT MACRO (16 in this HW) given a size_t size input.
  * If the input size is less then 32 (MIN_BLOCK_SIZE) however, it will round up to 32 (MIN_BLOCK_SIZE) automatically
@@ -66,8 +160,8 @@ size_t r_u_m16(size_t size) {
  *      0 -> a "good" boundary tag, -1 -> boundary tag went wrong.
  */
 int is_invalid_bt(size_t *boundary_tag) {
-    *boundary_tag = xor_magic(*boundary_tag);
-    size_t size = *boundary_tag & (~BINARY_LOWER_FOUR_ON);
+    // read a copy, so that the tag is never seen unobfuscated by other threads.
+    size_t size = xor_magic(*boundary_tag) & (~BINARY_LOWER_FOUR_ON);
     // means the boundry_tag size is smaller then 32, which is impossible.
     if (size < MIN_BLOCK_SIZE) {
         return -1;
@@ -76,7 +170,6 @@ int is_invalid_bt(size_t *boundary_tag) {
     if (size % ALLIGNMENT != 0) {
         return -1;
     }
-    *boundary_tag = xor_magic(*boundary_tag);
     return 0;
 }
 
@@ -169,10 +262,19 @@ char is_in_quick(size_t boundary_tag) {
  *
  */
 void init_free_list() {
+    free_list_bitmap = 0;
     for (int i = 0; i < NUM_FREE_LISTS; i++) {
         sf_free_list_heads[i].body.links.prev = &sf_free_list_heads[i];
         sf_free_list_heads[i].body.links.next = &sf_free_list_heads[i];
     }
+    tlsf_fl_bitmap = 0;
+    for (int i = 0; i < TLSF_FL_COUNT; i++) {
+        tlsf_sl_bitmap[i] = 0;
+        for (int j = 0; j < TLSF_SL_COUNT; j++) {
+            tlsf_heads[i][j].body.links.prev = &tlsf_heads[i][j];
+            tlsf_heads[i][j].body.links.next = &tlsf_heads[i][j];
+        }
+    }
 }
 
 /**
@@ -216,37 +318,62 @@ int is_invalid_free_list_free_block_footer(sf_footer *footer) {
     return 0;
 }
 
-int is_invalid_pointer_address(void *address) {
+/**
+ * @brief Validate the address of a payload using only the header of its block.
+ *
+ * @param address
+ *      the payload address.
+ * @return int
+ *      0 -> header describes an allocated block, -1 -> invalid.
+ */
+static int is_invalid_block_header(void *address) {
     if (address == NULL) {
         fprintf(stderr, "ERROR: pointer provide is invalid as it is NULL\n");
         return -1;
     }
     // the pp is the payload address, -8 to get to the header
     sf_header *header_of_block = address - BOUNDRY_TAG_SIZE;
+    void *start = __atomic_load_n(&heap_start, __ATOMIC_ACQUIRE);
+    void *end = __atomic_load_n(&heap_end, __ATOMIC_ACQUIRE);
+    if (start == NULL) {
+        fprintf(stderr, "ERROR: pointer provide is Invalid as the heap is not created yet.\n");
+        return -1;
+    }
     // if address of the header of the block we're attemping to free is below our heap starting address
-    if ((void *)header_of_block < sf_mem_start() + BOUNDRY_TAG_SIZE + MIN_BLOCK_SIZE) {
+    if ((void *)header_of_block < start + BOUNDRY_TAG_SIZE + MIN_BLOCK_SIZE) {
         fprintf(stderr, "ERROR: pointer provide is Invalid as its address is smaller then heap beginning address.\n");
         return -1;
     }
     // if address of the header is larger then the heap address space
-    if ((void *)header_of_block > sf_mem_end() - BOUNDRY_TAG_SIZE - MIN_BLOCK_SIZE) {
+    if ((void *)header_of_block > end - BOUNDRY_TAG_SIZE - MIN_BLOCK_SIZE) {
         fprintf(stderr, "ERROR: pointer provide is Invalid as its address is larger then heap ending address.\n");
         return -1;
     }
+    // read once, atomically: in thread-safe mode, sf_free calls this without heap_lock while other
+    // threads may be updating the PREV_BLOCK_ALLOCATED bit of this header (see set_prev_alloc_bit).
+    sf_header header = __atomic_load_n(header_of_block, __ATOMIC_RELAXED);
     // address multiple of 16, size >= 32
-    if (is_invalid_bt(header_of_block)) {
+    if (is_invalid_bt(&header)) {
         fprintf(stderr, "ERROR: pointer value indicated either it is size less then 32, not a multiple of 16.\n");
         return -1;
     }
     // the block is not allocated.
-    if (!is_current_alloc(*header_of_block)) {
+    if (!is_current_alloc(header)) {
         fprintf(stderr, "ERROR: pointer provide is Invalid as it is not an allocated block.\n");
         return -1;
     }
-    if (is_current_alloc(*header_of_block) && is_in_quick(*header_of_block)) {
+    if (is_current_alloc(header) && is_in_quick(header)) {
         fprintf(stderr, "ERROR: pointer provide is Invalid as it is in the quicklist.\n");
         return -1;
     }
+    return 0;
+}
+
+int is_invalid_pointer_address(void *address) {
+    if (is_invalid_block_header(address)) {
+        return -1;
+    }
+    sf_header *header_of_block = address - BOUNDRY_TAG_SIZE;
     // the prev_block indicate by current header is free, but reading prev_block footer it is not free.
     if (!(xor_magic(*header_of_block) & PREV_BLOCK_ALLOCATED)) {
         sf_footer *footer_of_prev_block = (void *)header_of_block - BOUNDRY_TAG_SIZE;
@@ -264,6 +391,7 @@ int is_invalid_pointer_address(void *address) {
 
 /**
  * @brief Determine the index of the main_list we should start searching from.
+ * List i > 0 holds (M * 2^(i-1), M * 2^i], so (size - 1) / M has exactly i significant bits.
  *
  * @param size
  *      the size of the element that we want to allocate for.
@@ -271,12 +399,12 @@ int is_invalid_pointer_address(void *address) {
  *      an number from [0,9] to indicate where we need to start searching from.
  */
 int determine_free_list_index(size_t size) {
-    int main_list_index = 0, main_list_size = MIN_BLOCK_SIZE;
-    while (size > main_list_size && main_list_index < NUM_FREE_LISTS - 1) {
-        main_list_size *= 2;
-        main_list_index++;
+    if (size <= MIN_BLOCK_SIZE) {
+        return 0;
     }
-    return main_list_index;
+    size_t multiple = (size - 1) / MIN_BLOCK_SIZE;
+    int main_list_index = sizeof(unsigned long) * 8 - __builtin_clzl(multiple);
+    return main_list_index < NUM_FREE_LISTS - 1 ? main_list_index : NUM_FREE_LISTS - 1;
 }
 
 /**
@@ -286,8 +414,62 @@ int determine_free_list_index(size_t size) {
  *      the pointer address to the block
  */
 void remove_block_from_free_list(sf_block *block) {
-    block->body.links.prev->body.links.next = block->body.links.next;
-    block->body.links.next->body.links.prev = block->body.links.prev;
+    sf_block *prev = block->body.links.prev, *next = block->body.links.next;
+    prev->body.links.next = next;
+    next->body.links.prev = prev;
+    // the list is now empty if only its dummy header is left.
+    if (prev == next && prev >= sf_free_list_heads && prev < sf_free_list_heads + NUM_FREE_LISTS) {
+        free_list_bitmap &= ~(1u << (prev - sf_free_list_heads));
+    } else if (prev == next && prev >= &tlsf_heads[0][0] && prev < &tlsf_heads[0][0] + TLSF_FL_COUNT * TLSF_SL_COUNT) {
+        int fl = (prev - &tlsf_heads[0][0]) / TLSF_SL_COUNT, sl = (prev - &tlsf_heads[0][0]) % TLSF_SL_COUNT;
+        tlsf_sl_bitmap[fl] &= ~(1u << sl);
+        if (tlsf_sl_bitmap[fl] == 0) {
+            tlsf_fl_bitmap &= ~(1u << fl);
+        }
+    }
+}
+
+/**
+ * @brief Determine the TLSF list of a block size: the first level is the power of two below it,
+ * the second level the next TLSF_SL_LOG2 bits.
+ *
+ * @param size
+ *      the size of the block.
+ * @param fl
+ *      where to store the first level index.
+ * @param sl
+ *      where to store the second level index.
+ * @return int
+ *      0 -> done, -1 -> the size is beyond the last list.
+ */
+static int tlsf_mapping(size_t size, int *fl, int *sl) {
+    int bit = sizeof(unsigned long) * 8 - 1 - __builtin_clzl(size);
+    if (bit - TLSF_FL_SHIFT >= TLSF_FL_COUNT) {
+        return -1;
+    }
+    *fl = bit - TLSF_FL_SHIFT;
+    *sl = (size >> (bit - TLSF_SL_LOG2)) & (TLSF_SL_COUNT - 1);
+    return 0;
+}
+
+/**
+ * @brief Insert a block into its TLSF list (assuming the header and footer is done correctly)
+ *
+ * @param new_block
+ *      the pointer to the new block.
+ * @param new_block_size
+ *      the block_Size of this block is supposed to be.
+ */
+static void tlsf_insert(sf_block *new_block, size_t new_block_size) {
+    int fl = TLSF_FL_COUNT - 1, sl = TLSF_SL_COUNT - 1;
+    tlsf_mapping(new_block_size, &fl, &sl);
+    sf_block *head = &tlsf_heads[fl][sl];
+    new_block->body.links.next = head->body.links.next;
+    head->body.links.next->body.links.prev = new_block;
+    head->body.links.next = new_block;
+    new_block->body.links.prev = head;
+    tlsf_sl_bitmap[fl] |= 1u << sl;
+    tlsf_fl_bitmap |= 1u << fl;
 }
 
 /**
@@ -299,11 +481,32 @@ void remove_block_from_free_list(sf_block *block) {
  *      the block_Size of this block is supposed to be.
  */
 void insert_block_to_free_list(sf_block *new_block, size_t new_block_size) {
+    if (tlsf) {
+        tlsf_insert(new_block, new_block_size);
+        return;
+    }
     int insert_index = determine_free_list_index(new_block_size);
     new_block->body.links.next = sf_free_list_heads[insert_index].body.links.next;
     sf_free_list_heads[insert_index].body.links.next->body.links.prev = new_block;
     sf_free_list_heads[insert_index].body.links.next = new_block;
     new_block->body.links.prev = &(sf_free_list_heads[insert_index]);
+    free_list_bitmap |= 1u << insert_index;
+}
+
+/**
+ * @brief Turn the PREV_BLOCK_ALLOCATED bit of a header on or off. The block may be allocated and in
+ * the cache of another thread, whose sf_free reads the header without heap_lock, so the new value
+ * is written with a single atomic store, and nothing else ever writes a cached block's header.
+ *
+ * @param header
+ *      the header of the block after the one whose allocation changed.
+ * @param prev_alloc
+ *      0 -> prev block not allocated, 1 -> prev block allocated
+ */
+static void set_prev_alloc_bit(sf_header *header, char prev_alloc) {
+    size_t value = xor_magic(*header);
+    value = prev_alloc ? value | PREV_BLOCK_ALLOCATED : value & ~PREV_BLOCK_ALLOCATED;
+    __atomic_store_n(header, xor_magic(value), __ATOMIC_RELAXED);
 }
 
 /**
@@ -314,7 +517,7 @@ void insert_block_to_free_list(sf_block *new_block, size_t new_block_size) {
  */
 void update_prev_alloc_next_block(sf_footer *current_footer) {
     sf_header *header = (void *)current_footer + BOUNDRY_TAG_SIZE;
-    *header = xor_magic(xor_magic(*header) & (~PREV_BLOCK_ALLOCATED));
+    set_prev_alloc_bit(header, 0);
     if (!is_current_alloc(*header)) {
         sf_footer *footer = (void *)header + block_size_bt(*header) - BOUNDRY_TAG_SIZE;
         *footer = *header;
@@ -332,16 +535,16 @@ void update_prev_alloc_next_block(sf_footer *current_footer) {
  */
 void *allocate_block_no_split(sf_block *block) {
     size_t size = block_size_bt(block->header);
-    real_heap_usage += (size - BOUNDRY_TAG_SIZE);
+    add_heap_usage(size - BOUNDRY_TAG_SIZE);
     debug("no split allocation addition: prev_real_size: %lu, addition: %lu, now_real: %lu\n", real_heap_usage - (size - BOUNDRY_TAG_SIZE), (size - BOUNDRY_TAG_SIZE), real_heap_usage);
-    max = real_heap_usage > max ? real_heap_usage : max;
     sf_header *header_of_block_to_allocate = &(block->header);
     char is_prev = is_prev_alloc(*header_of_block_to_allocate);
     update_bt(header_of_block_to_allocate, size, is_prev, 1, 0);
     sf_header *header_of_next_block = (void *)&(block->header) + size;
     size_t size_of_next_block = block_size_bt(*header_of_next_block);
-    *header_of_next_block = xor_magic(xor_magic(*header_of_next_block) | PREV_BLOCK_ALLOCATED);
-    if (is_current_alloc(*header_of_next_block)) {
+    set_prev_alloc_bit(header_of_next_block, 1);
+    // only a free block has a footer; an allocated one has payload there.
+    if (!is_current_alloc(*header_of_next_block)) {
         sf_footer *footer_of_next_block = (void *)header_of_next_block + size_of_next_block - BOUNDRY_TAG_SIZE;
         *footer_of_next_block = *header_of_next_block;
     }
@@ -363,9 +566,8 @@ void *allocate_block_with_splitting(sf_block *block, size_t required_size) {
     size_t size = block_size_bt(block->header);
     sf_header *header_of_block_to_allocate = &(block->header);
     char is_prev = is_prev_alloc(*header_of_block_to_allocate);
-    real_heap_usage += (required_size - BOUNDRY_TAG_SIZE);
+    add_heap_usage(required_size - BOUNDRY_TAG_SIZE);
     debug("split allocation addition: prev_real_size: %lu, addition: %lu, now_real: %lu\n", real_heap_usage - (required_size - BOUNDRY_TAG_SIZE), (required_size - BOUNDRY_TAG_SIZE), real_heap_usage);
-    max = real_heap_usage > max ? real_heap_usage : max;
     update_bt(header_of_block_to_allocate, required_size, is_prev, 1, 0);
 
     // set-up the split block
@@ -385,6 +587,48 @@ void *allocate_block_with_splitting(sf_block *block, size_t required_size) {
     return (void *)header_of_block_to_allocate + BOUNDRY_TAG_SIZE;
 }
 
+/**
+ * @brief TLSF version of search_heap_and_allocate: round the size up to the next list boundary,
+ * so that every block of the first non-empty list at or above it fits, and take the first one.
+ * If there is none, the first block of the list of the size itself may still fit.
+ */
+static int tlsf_search_and_allocate(void **pointer, char *isAllocated, size_t size) {
+    int bit = sizeof(unsigned long) * 8 - 1 - __builtin_clzl(size);
+    size_t rounded = size + ((size_t)1 << (bit - TLSF_SL_LOG2)) - 1;
+    int fl, sl;
+    sf_block *block = NULL;
+    if (tlsf_mapping(rounded, &fl, &sl) == 0) {
+        unsigned int sl_map = tlsf_sl_bitmap[fl] & (~0u << sl);
+        if (sl_map == 0) {
+            unsigned int fl_map = fl + 1 < TLSF_FL_COUNT ? tlsf_fl_bitmap & (~0u << (fl + 1)) : 0;
+            if (fl_map != 0) {
+                fl = __builtin_ctz(fl_map);
+                sl_map = tlsf_sl_bitmap[fl];
+            }
+        }
+        if (sl_map != 0) {
+            block = tlsf_heads[fl][__builtin_ctz(sl_map)].body.links.next;
+        }
+    }
+    if (block == NULL && tlsf_mapping(size, &fl, &sl) == 0) {
+        sf_block *first = tlsf_heads[fl][sl].body.links.next;
+        if (first != &tlsf_heads[fl][sl] && block_size_bt(first->header) >= size) {
+            block = first;
+        }
+    }
+    if (block == NULL) {
+        return -1;
+    }
+    remove_block_from_free_list(block);
+    if (block_size_bt(block->header) - MIN_BLOCK_SIZE >= size) {
+        *pointer = allocate_block_with_splitting(block, size);
+    } else {
+        *pointer = allocate_block_no_split(block);
+    }
+    *isAllocated = 1;
+    return 0;
+}
+
 /**
  * @brief Search main free_list for memory and attempt to allocate if possible.
  *
@@ -398,11 +642,14 @@ void *allocate_block_with_splitting(sf_block *block, size_t required_size) {
  *      0 = success, -1 = fail to find a space
  */
 int search_heap_and_allocate(void **pointer, char *isAllocated, size_t size) {
+    if (tlsf) {
+        return tlsf_search_and_allocate(pointer, isAllocated, size);
+    }
     int main_list_index = determine_free_list_index(size);
-    for (int i = main_list_index; i < NUM_FREE_LISTS && !*isAllocated; i++) {
-        if (sf_free_list_heads[i].body.links.next == &sf_free_list_heads[i]) {
-            continue;
-        }
+    // only the non-empty lists from main_list_index up; any block in a list above main_list_index fits.
+    unsigned int candidates = free_list_bitmap & (~0u << main_list_index);
+    for (; candidates != 0 && !*isAllocated; candidates &= candidates - 1) {
+        int i = __builtin_ctz(candidates);
         sf_block *dummy_header = &sf_free_list_heads[i];
         sf_block *traverse = sf_free_list_heads[i].body.links.next;
         while (!*isAllocated && traverse != dummy_header) {
@@ -503,13 +750,225 @@ void coalesce_current(sf_header *current_block_header) {
     // so no coal attempt made or coal attempts sucess.
 }
 
+/**
+ * @brief Grow the heap, in one go, by the number of pages a block of the given size needs at its end
+ * (counting the free block already there, which the new pages are coalesced with), or by the
+ * number heap_growth asks for if that is more. The pages become a single free block.
+ *
+ * @param size
+ *      the size of the block that did not fit.
+ * @return int
+ *      0 -> the heap has grown enough, -1 -> it could not (sf_errno is set; whatever pages it
+ *      did get are still added as a free block).
+ */
+static int grow_heap(size_t size) {
+    sf_footer *prev_epilogue = sf_mem_end() - BOUNDRY_TAG_SIZE;
+    char is_prev_taken = is_prev_alloc(*prev_epilogue);
+    sf_header *prev_block_header = 0x0;
+    size_t size_of_prev = 0;
+    if (!is_prev_taken) {
+        sf_footer *prev_block_footer = (void *)prev_epilogue - BOUNDRY_TAG_SIZE;
+        if (is_invalid_bt(prev_block_footer) || is_current_alloc(*prev_block_footer)) {
+            fprintf(stderr, "ERROR: previous block footer has been corrupted when attempt to coalescing\n");
+            sf_errno = ENOMEM;
+            return -1;
+        }
+        size_of_prev = block_size_bt(*prev_block_footer);
+        prev_block_header = (void *)prev_epilogue - size_of_prev;
+        if (xor_magic(*prev_block_header) != xor_magic(*prev_block_footer)) {
+            fprintf(stderr, "ERROR: Coalescing has failed due to prev_block header does not contain appropriate value.\n");
+            sf_errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    // at least one page, in case the block at the end was big enough but not found by the search.
+    size_t needed_pages = size > size_of_prev ? (size - size_of_prev + PAGE_SZ - 1) / PAGE_SZ : 1;
+    size_t wanted_pages = needed_pages;
+    if (heap_growth != 0) {
+        size_t heap_pages = (sf_mem_end() - sf_mem_start()) / PAGE_SZ;
+        size_t policy_pages = (heap_pages * heap_growth + 99) / 100;
+        if (policy_pages > wanted_pages) {
+            wanted_pages = policy_pages;
+        }
+    }
+    // pages beyond the needed ones are only taken if the heap can still grow.
+    size_t grown_pages = 0;
+    while (grown_pages < wanted_pages && sf_mem_grow() != NULL) {
+        grown_pages++;
+    }
+    if (grown_pages == 0) {
+        fprintf(stderr, "ERROR: Ask for more memory from kernel but does not recieve any.\n");
+        sf_errno = ENOMEM;
+        return -1;
+    }
+
+    size_t grown_size = grown_pages * PAGE_SZ;
+    update_bt(prev_epilogue, grown_size, is_prev_taken, 0, 0);
+    sf_footer *footer_of_new_block = (void *)prev_epilogue + grown_size - BOUNDRY_TAG_SIZE;
+    update_bt(footer_of_new_block, grown_size, is_prev_taken, 0, 0);
+    sf_footer *epilogue = sf_mem_end() - BOUNDRY_TAG_SIZE;
+    update_bt(epilogue, 0, 0, 1, 0);
+    update_heap_bounds();
+    if (!is_prev_taken) {
+        special_coalesce_new_mem(prev_block_header, footer_of_new_block);
+    } else {
+        insert_block_to_free_list((void *)prev_epilogue - BOUNDRY_TAG_SIZE, grown_size);
+    }
+
+    if (grown_pages < needed_pages) {
+        fprintf(stderr, "ERROR: Ask for more memory from kernel but does not recieve any.\n");
+        sf_errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
 // ---------------------------   END OF MALLOC HELPER    --------------------------- //
 
+// ------------------------- START OF LARGE OBJECT CODE  --------------------------- //
+
+/**
+ * @brief Round a size up to a multiple of the system page size.
+ */
+static size_t round_up_system_page(size_t size) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    return (size + page - 1) / page * page;
+}
+
+/**
+ * @brief Find the slot of a mapping in the large object table, or the empty slot it would go in.
+ *
+ * @param address
+ *      the start of the mapping, which is the payload address.
+ * @return int
+ *      the index of the slot.
+ */
+static int large_slot(void *address) {
+    int slot = ((uintptr_t)address >> 12) * 0x9e3779b97f4a7c15ull >> 32 & (LARGE_TABLE_SIZE - 1);
+    while (large_table[slot].address != NULL && large_table[slot].address != address) {
+        slot = (slot + 1) & (LARGE_TABLE_SIZE - 1);
+    }
+    return slot;
+}
+
+/**
+ * @brief Determine whether a pointer is the payload of a large object.
+ *
+ * @param pp
+ *      the pointer given to sf_free or sf_realloc.
+ * @return int
+ *      the slot of the object in the large object table, -1 if it is not one.
+ */
+static int large_object_of(void *pp) {
+    // a payload in the heap is never a large object, nor the other way round.
+    if (__atomic_load_n(&large_count, __ATOMIC_RELAXED) == 0 || pp == NULL
+        || (pp >= __atomic_load_n(&heap_start, __ATOMIC_ACQUIRE) && pp < __atomic_load_n(&heap_end, __ATOMIC_ACQUIRE))) {
+        return -1;
+    }
+    int slot = large_slot(pp);
+    return large_table[slot].address == NULL ? -1 : slot;
+}
+
+/**
+ * @brief Take a large object out of the table, moving later entries of its probe run back so
+ * that none of them is cut off from its home slot.
+ *
+ * @param slot
+ *      the slot of the object.
+ */
+static void large_remove(int slot) {
+    large_table[slot].address = NULL;
+    __atomic_sub_fetch(&large_count, 1, __ATOMIC_RELAXED);
+    int next = (slot + 1) & (LARGE_TABLE_SIZE - 1);
+    while (large_table[next].address != NULL) {
+        large_object moved = large_table[next];
+        large_table[next].address = NULL;
+        large_table[large_slot(moved.address)] = moved;
+        next = (next + 1) & (LARGE_TABLE_SIZE - 1);
+    }
+}
+
+/**
+ * @brief Map a large object of its own.
+ *
+ * @param size
+ *      the requested payload size.
+ * @return void*
+ *      the payload, NULL if the table is full or the mapping failed (the heap is tried instead).
+ */
+static void *large_malloc(size_t size) {
+    if (__atomic_load_n(&large_count, __ATOMIC_RELAXED) == LARGE_MAX_OBJECTS) {
+        return NULL;
+    }
+    size_t length = round_up_system_page(size);
+    void *address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (address == MAP_FAILED) {
+        return NULL;
+    }
+    int slot = large_slot(address);
+    large_table[slot].address = address;
+    large_table[slot].length = length;
+    __atomic_add_fetch(&large_count, 1, __ATOMIC_RELAXED);
+    return address;
+}
+
+/**
+ * @brief Unmap a large object, returning its memory to the system.
+ *
+ * @param slot
+ *      the slot of the object in the large object table.
+ */
+static void large_free(int slot) {
+    munmap(large_table[slot].address, large_table[slot].length);
+    large_remove(slot);
+}
+
+/**
+ * @brief Resize the mapping of a large object, in place if the pages after it are free, otherwise
+ * by moving its pages elsewhere, which does not copy them.
+ *
+ * @param slot
+ *      the slot of the object in the large object table.
+ * @param size
+ *      the new payload size.
+ * @return void*
+ *      the payload, NULL if the mapping could not be resized (it is left as it was).
+ */
+static void *large_remap(int slot, size_t size) {
+    large_object object = large_table[slot];
+    size_t length = round_up_system_page(size);
+    if (length == object.length) {
+        return object.address;
+    }
+    void *address = mremap(object.address, object.length, length, MREMAP_MAYMOVE);
+    if (address == MAP_FAILED) {
+        return NULL;
+    }
+    large_remove(slot);
+    slot = large_slot(address);
+    large_table[slot].address = address;
+    large_table[slot].length = length;
+    __atomic_add_fetch(&large_count, 1, __ATOMIC_RELAXED);
+    return address;
+}
+
+// -------------------------   END OF LARGE OBJECT CODE  --------------------------- //
+
 // ---------------------------  START OF sf_malloc CODE  --------------------------- //
 
-void *sf_malloc(size_t size) {
+/**
+ * @brief sf_malloc on the shared heap (the caller holds heap_lock in thread-safe mode).
+ */
+static void *heap_malloc(size_t size) {
     // the return address variable
     void *new_begin_mem_pointer = 0x0;
+    if (large_threshold != 0 && size >= large_threshold) {
+        new_begin_mem_pointer = large_malloc(size);
+        if (new_begin_mem_pointer != NULL) {
+            return new_begin_mem_pointer;
+        }
+    }
     // means the heap is nost created yet
     if (sf_mem_start() == sf_mem_end()) {
         new_begin_mem_pointer = sf_mem_grow();
@@ -542,6 +1001,7 @@ void *sf_malloc(size_t size) {
         // set up epilogue
         sf_footer *epilogue = sf_mem_end() - 8;
         update_bt(epilogue, 0, 0, 1, 0);
+        update_heap_bounds();
     }
 
     // size 0, return null and don't set anything
@@ -569,42 +1029,11 @@ void *sf_malloc(size_t size) {
         }
     }
 
-    // allocate if page has enough memory, if not continue to allocate for page space.
+    // allocate if page has enough memory, if not grow the heap by enough pages and search again.
     while (!isAllocated && search_heap_and_allocate(&new_begin_mem_pointer, &isAllocated, size) == -1) {
-        sf_footer *prev_epilogue = sf_mem_end() - BOUNDRY_TAG_SIZE;
-        void *additional_memory = sf_mem_grow();
-        if (additional_memory == NULL) {
-            fprintf(stderr, "ERROR: Ask for more memory from kernel but does not recieve any.\n");
-            sf_errno = ENOMEM;
+        if (grow_heap(size) == -1) {
             return NULL;
         }
-
-        char is_prev_taken = is_prev_alloc(*prev_epilogue);
-        update_bt(prev_epilogue, PAGE_SZ, is_prev_taken, 0, 0);
-        sf_footer *footer_of_new_block = (void *)prev_epilogue + PAGE_SZ - BOUNDRY_TAG_SIZE;
-        update_bt(footer_of_new_block, PAGE_SZ, is_prev_taken, 0, 0);
-        sf_footer *epilogue = sf_mem_end() - BOUNDRY_TAG_SIZE;
-        update_bt(epilogue, 0, 0, 1, 0);
-
-        sf_header *prev_block_header = 0x0;
-        if (!is_prev_taken) {
-            sf_footer *prev_block_footer = (void *)prev_epilogue - BOUNDRY_TAG_SIZE;
-            if (is_invalid_bt(prev_block_footer) || is_current_alloc(*prev_block_footer)) {
-                fprintf(stderr, "ERROR: previous block footer has been corrupted when attempt to coalescing\n");
-                sf_errno = ENOMEM;
-                return NULL;
-            }
-            size_t size_of_prev = block_size_bt(*prev_block_footer);
-            prev_block_header = (void *)prev_epilogue - size_of_prev;
-            if (xor_magic(*prev_block_header) != xor_magic(*prev_block_footer)) {
-                fprintf(stderr, "ERROR: Coalescing has failed due to prev_block header does not contain appropriate value.\n");
-                sf_errno = ENOMEM;
-                return NULL;
-            }
-            special_coalesce_new_mem(prev_block_header, footer_of_new_block);
-        } else {
-            insert_block_to_free_list((void *)prev_epilogue - BOUNDRY_TAG_SIZE, PAGE_SZ);
-        }
     }
     // sf_show_heap();
     return new_begin_mem_pointer;
@@ -625,7 +1054,7 @@ void *sf_malloc(size_t size) {
  */
 void insert_block_to_quick_list(sf_header *header, int index, size_t current_block_size) {
     *header = xor_magic(xor_magic(*header) | IN_QUICK_LIST);
-    real_heap_usage -= (current_block_size - BOUNDRY_TAG_SIZE);
+    sub_heap_usage(current_block_size - BOUNDRY_TAG_SIZE);
     debug("insert_block_to_quick_list prev_real_size: %lu, subtraction: %lu, now_real: %lu\n", real_heap_usage + (current_block_size - BOUNDRY_TAG_SIZE), (current_block_size - BOUNDRY_TAG_SIZE), real_heap_usage);
     sf_block *block = (void *)header - BOUNDRY_TAG_SIZE;
     block->body.links.next = sf_quick_lists[index].first;
@@ -637,7 +1066,15 @@ void insert_block_to_quick_list(sf_header *header, int index, size_t current_blo
 
 // ---------------------------   START OF sf_free CODE   --------------------------- //
 
-void sf_free(void *pp) {
+/**
+ * @brief sf_free on the shared heap (the caller holds heap_lock in thread-safe mode).
+ */
+static void heap_free(void *pp) {
+    int large_object_slot = large_object_of(pp);
+    if (large_object_slot != -1) {
+        large_free(large_object_slot);
+        return;
+    }
     if (is_invalid_pointer_address(pp)) {
         abort();
     }
@@ -675,6 +1112,7 @@ void sf_free(void *pp) {
                 coalesce_current(header);
             }
             sf_quick_lists[quick_list_index].first = NULL;
+            sf_quick_lists[quick_list_index].length = 0;
         }
         insert_block_to_quick_list(header_of_block, quick_list_index, current_block_size);
         return;
@@ -686,7 +1124,7 @@ void sf_free(void *pp) {
     *footer_of_block = *header_of_block;
     update_prev_alloc_next_block(footer_of_block);
 
-    real_heap_usage -= (current_block_size - BOUNDRY_TAG_SIZE);
+    sub_heap_usage(current_block_size - BOUNDRY_TAG_SIZE);
     debug("free normal subtraction: prev_real_size: %lu, subtraction: %lu, now_real: %lu\n", real_heap_usage + (current_block_size - BOUNDRY_TAG_SIZE), (current_block_size - BOUNDRY_TAG_SIZE), real_heap_usage);
 
 
@@ -700,14 +1138,89 @@ void sf_free(void *pp) {
 
 // --------------------------- START OF sf_realloc CODE  --------------------------- //
 
-void *sf_realloc(void *pp, size_t rsize) {
+/**
+ * @brief Grow an allocated block in place by taking over the free block after it, after growing
+ * the heap if that block, or the block itself, is the last one and too small.
+ *
+ * @param header_of_block
+ *      the header of the block.
+ * @param required_size
+ *      the block size required, larger than the current one.
+ * @return int
+ *      0 -> done, -1 -> there is not enough room after the block, which is left as it was.
+ */
+static int grow_block_in_place(sf_header *header_of_block, size_t required_size) {
+    size_t size = block_size_bt(*header_of_block);
+    sf_header *next_header = (void *)header_of_block + size;
+    size_t next_size = is_current_alloc(*next_header) ? 0 : block_size_bt(*next_header);
+    if (size + next_size < required_size && (void *)next_header + next_size == sf_mem_end() - BOUNDRY_TAG_SIZE) {
+        // the new pages become (or join) the free block after this one.
+        int saved_errno = sf_errno;
+        if (grow_heap(required_size - size) == -1) {
+            sf_errno = saved_errno;
+        }
+        next_size = block_size_bt(*next_header);
+    }
+    if (size + next_size < required_size) {
+        return -1;
+    }
+
+    remove_block_from_free_list((void *)next_header - BOUNDRY_TAG_SIZE);
+    size_t new_size = size + next_size;
+    char is_prev = is_prev_alloc(*header_of_block);
+    sub_heap_usage(size - BOUNDRY_TAG_SIZE);
+    if (new_size - required_size >= MIN_BLOCK_SIZE) {
+        update_bt(header_of_block, required_size, is_prev, 1, 0);
+        sf_header *split_header = (void *)header_of_block + required_size;
+        size_t split_size = new_size - required_size;
+        update_bt(split_header, split_size, 1, 0, 0);
+        sf_footer *split_footer = (void *)split_header + split_size - BOUNDRY_TAG_SIZE;
+        *split_footer = *split_header;
+        insert_block_to_free_list((void *)split_header - BOUNDRY_TAG_SIZE, split_size);
+        add_heap_usage(required_size - BOUNDRY_TAG_SIZE);
+    } else {
+        // the block after the free one is allocated (or the epilogue), since free blocks are coalesced.
+        update_bt(header_of_block, new_size, is_prev, 1, 0);
+        sf_header *after_header = (void *)header_of_block + new_size;
+        set_prev_alloc_bit(after_header, 1);
+        add_heap_usage(new_size - BOUNDRY_TAG_SIZE);
+    }
+    return 0;
+}
+
+/**
+ * @brief sf_realloc on the shared heap (the caller holds heap_lock in thread-safe mode).
+ */
+static void *heap_realloc(void *pp, size_t rsize) {
     // sf_show_heap();
+    int large_object_slot = large_object_of(pp);
+    if (large_object_slot != -1) {
+        if (rsize == 0) {
+            large_free(large_object_slot);
+            return NULL;
+        }
+        if (large_threshold != 0 && rsize >= large_threshold) {
+            void *new_address = large_remap(large_object_slot, rsize);
+            if (new_address == NULL) {
+                sf_errno = ENOMEM;
+            }
+            return new_address;
+        }
+        // it is now small enough for the heap
+        void *new_address = heap_malloc(rsize);
+        if (new_address == NULL) {
+            return NULL;
+        }
+        memcpy(new_address, pp, rsize);
+        large_free(large_object_slot);
+        return new_address;
+    }
     if (is_invalid_pointer_address(pp)) {
         sf_errno = EINVAL;
         return NULL;
     }
     if (rsize == 0) {
-        sf_free(pp);
+        heap_free(pp);
         return NULL;
     }
     // the pp is the payload address, -8 to get to the header
@@ -715,13 +1228,25 @@ void *sf_realloc(void *pp, size_t rsize) {
     size_t actual_rsize = r_u_m16(rsize + BOUNDRY_TAG_SIZE);
     size_t size = block_size_bt(*header_of_block);
     if (actual_rsize > size) {
-        void *new_address = sf_malloc(rsize);
+        // grown to the large threshold, it moves out of the heap even if it could grow in place.
+        if (large_threshold != 0 && rsize >= large_threshold) {
+            void *new_address = large_malloc(rsize);
+            if (new_address != NULL) {
+                memcpy(new_address, pp, size - BOUNDRY_TAG_SIZE);
+                heap_free(pp);
+                return new_address;
+            }
+        }
+        if (realloc_in_place && grow_block_in_place(header_of_block, actual_rsize) == 0) {
+            return pp;
+        }
+        void *new_address = heap_malloc(rsize);
         if (new_address == NULL) {
             fprintf(stderr, "ERROR: sf_realloc failed as sf_malloc failed to allocate memory for the new size.\n");
             return NULL;
         }
         memcpy(new_address, (void *)header_of_block + BOUNDRY_TAG_SIZE, size - BOUNDRY_TAG_SIZE);
-        sf_free(pp);
+        heap_free(pp);
         return new_address;
     }
     if (actual_rsize < size) {
@@ -736,8 +1261,8 @@ void *sf_realloc(void *pp, size_t rsize) {
         update_bt(new_split_header, size - actual_rsize, 1, 0, 0);
         sf_footer *new_split_footer = (void *)new_split_header + (size - actual_rsize) - BOUNDRY_TAG_SIZE;
         *new_split_footer = *new_split_header;
-        real_heap_usage -= (size - BOUNDRY_TAG_SIZE);
-        real_heap_usage += (actual_rsize - BOUNDRY_TAG_SIZE);
+        sub_heap_usage(size - BOUNDRY_TAG_SIZE);
+        add_heap_usage(actual_rsize - BOUNDRY_TAG_SIZE);
         debug("realloc subtraction: prev_real_size: %lu, subtraction: %lu, addition: %lu, now_real: %lu\n", real_heap_usage + (size - BOUNDRY_TAG_SIZE) - (actual_rsize - BOUNDRY_TAG_SIZE), (size - BOUNDRY_TAG_SIZE), (actual_rsize - BOUNDRY_TAG_SIZE), real_heap_usage);
 
         sf_block *block = (void *)new_split_header - BOUNDRY_TAG_SIZE;
@@ -752,6 +1277,266 @@ void *sf_realloc(void *pp, size_t rsize) {
 }
 // ---------------------------   END OF sf_realloc CODE  --------------------------- //
 
+// ------------------------- START OF THREAD CACHE CODE  --------------------------- //
+
+/**
+ * @brief Determine the quick_list index of a block size.
+ *
+ * @param block_size
+ *      the size of the block.
+ * @return int
+ *      the index of the quick_list holding blocks of this size, -1 if there is none.
+ */
+static int quick_list_index_of(size_t block_size) {
+    if (block_size <= MAX_QUICK_LIST_BLOCK_SIZE && (block_size - MIN_BLOCK_SIZE) % ALLIGNMENT == 0) {
+        return (block_size - MIN_BLOCK_SIZE) >> 4;
+    }
+    return -1;
+}
+
+/**
+ * @brief Put an allocated block into the cache of the calling thread (DOES NOT CHECK CONDITION).
+ * The block stays marked as allocated, and its header is left alone: other threads may change its
+ * PREV_BLOCK_ALLOCATED bit at any time. Whether it is cached is known only to the cache.
+ *
+ * @param header
+ *      header of the block.
+ * @param index
+ *      the index of the cache list, the same as that of the quick_list for its size.
+ * @param block_size
+ *      the size of the block.
+ */
+static void push_thread_cache(sf_header *header, int index, size_t block_size) {
+    sub_heap_usage(block_size - BOUNDRY_TAG_SIZE);
+    sf_block *block = (void *)header - BOUNDRY_TAG_SIZE;
+    block->body.links.next = local_cache.lists[index].first;
+    local_cache.lists[index].first = block;
+    local_cache.lists[index].length++;
+}
+
+/**
+ * @brief Take the first block out of a non-empty list of the cache of the calling thread.
+ *
+ * @param index
+ *      the index of the cache list.
+ * @return void*
+ *      the payload address of the block, which is now allocated.
+ */
+static void *pop_thread_cache(int index) {
+    sf_block *block = local_cache.lists[index].first;
+    local_cache.lists[index].first = block->body.links.next;
+    local_cache.lists[index].length--;
+    // every block of a list has the size of its quick_list, so the header need not be read.
+    add_heap_usage(MIN_BLOCK_SIZE + index * ALLIGNMENT - BOUNDRY_TAG_SIZE);
+    return (void *)&(block->header) + BOUNDRY_TAG_SIZE;
+}
+
+/**
+ * @brief Determine whether a block is in a list of the cache of the calling thread.
+ *
+ * @param block
+ *      the block.
+ * @param index
+ *      the index of the cache list for its size.
+ * @return int
+ *      1 -> it is (so freeing it again is a double free), 0 -> it is not.
+ */
+static int in_thread_cache(sf_block *block, int index) {
+    for (sf_block *cursor = local_cache.lists[index].first; cursor != NULL; cursor = cursor->body.links.next) {
+        if (cursor == block) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Return blocks from a list of the cache of the calling thread to the shared heap
+ * (the caller holds heap_lock).
+ *
+ * @param index
+ *      the index of the cache list.
+ * @param count
+ *      the number of blocks to return, at most.
+ */
+static void flush_thread_cache(int index, int count) {
+    while (count-- > 0 && local_cache.lists[index].length != 0) {
+        heap_free(pop_thread_cache(index));
+    }
+}
+
+/**
+ * @brief Fill a list of the cache of the calling thread up to THREAD_CACHE_BATCH blocks from the
+ * shared quick_list and free lists, without growing the heap (the caller holds heap_lock).
+ *
+ * @param index
+ *      the index of the cache list.
+ * @param block_size
+ *      the size of the blocks of the list.
+ */
+static void refill_thread_cache(int index, size_t block_size) {
+    while (local_cache.lists[index].length < THREAD_CACHE_BATCH) {
+        void *pp = NULL;
+        char isAllocated = 0;
+        if (sf_quick_lists[index].length != 0) {
+            sf_block *block = sf_quick_lists[index].first;
+            sf_quick_lists[index].first = block->body.links.next;
+            sf_quick_lists[index].length--;
+            pp = allocate_block_no_split(block);
+        } else if (search_heap_and_allocate(&pp, &isAllocated, block_size) == -1) {
+            return;
+        }
+        sf_header *header = pp - BOUNDRY_TAG_SIZE;
+        // a block too small to split is handed out whole, and does not belong in this list.
+        if (block_size_bt(*header) != block_size) {
+            heap_free(pp);
+            return;
+        }
+        push_thread_cache(header, index, block_size);
+    }
+}
+
+/**
+ * @brief Flush the whole cache of a thread that is exiting (destructor of thread_cache_key).
+ *
+ * @param cache
+ *      the cache of the exiting thread, which is also its local_cache.
+ */
+static void release_thread_cache(void *cache) {
+    pthread_mutex_lock(&heap_lock);
+    for (int i = 0; i < NUM_QUICK_LISTS; i++) {
+        flush_thread_cache(i, local_cache.lists[i].length);
+    }
+    pthread_mutex_unlock(&heap_lock);
+}
+
+static void create_thread_cache_key() {
+    pthread_key_create(&thread_cache_key, release_thread_cache);
+}
+
+/**
+ * @brief Arrange for the cache of the calling thread to be flushed when the thread exits.
+ */
+static void register_thread_cache() {
+    pthread_once(&thread_cache_once, create_thread_cache_key);
+    pthread_setspecific(thread_cache_key, &local_cache);
+    local_cache.registered = 1;
+}
+
+// -------------------------  END OF THREAD CACHE CODE   --------------------------- //
+
+// ------------------------  START OF PUBLIC ENTRY POINTS  ------------------------- //
+
+void *sf_malloc(size_t size) {
+    if (!thread_safe) {
+        return heap_malloc(size);
+    }
+    int index = -1;
+    size_t block_size = 0;
+    if (size != 0 && size < MAX_QUICK_LIST_BLOCK_SIZE) {
+        block_size = r_u_m16(size + BOUNDRY_TAG_SIZE);
+        index = quick_list_index_of(block_size);
+    }
+    // fast path: no lock
+    if (index >= 0 && local_cache.lists[index].length != 0) {
+        return pop_thread_cache(index);
+    }
+    pthread_mutex_lock(&heap_lock);
+    void *pp = heap_malloc(size);
+    if (pp != NULL && index >= 0) {
+        if (!local_cache.registered) {
+            register_thread_cache();
+        }
+        refill_thread_cache(index, block_size);
+    }
+    pthread_mutex_unlock(&heap_lock);
+    return pp;
+}
+
+void sf_free(void *pp) {
+    if (!thread_safe) {
+        heap_free(pp);
+        return;
+    }
+    if (__atomic_load_n(&large_count, __ATOMIC_RELAXED) != 0
+        && (pp < __atomic_load_n(&heap_start, __ATOMIC_ACQUIRE) || pp >= __atomic_load_n(&heap_end, __ATOMIC_ACQUIRE))) {
+        // a large object has no header: heap_free finds it in the table, or aborts.
+        pthread_mutex_lock(&heap_lock);
+        heap_free(pp);
+        pthread_mutex_unlock(&heap_lock);
+        return;
+    }
+    if (is_invalid_block_header(pp)) {
+        abort();
+    }
+    sf_header *header_of_block = pp - BOUNDRY_TAG_SIZE;
+    size_t block_size = block_size_bt(__atomic_load_n(header_of_block, __ATOMIC_RELAXED));
+    int index = quick_list_index_of(block_size);
+    if (index < 0) {
+        pthread_mutex_lock(&heap_lock);
+        heap_free(pp);
+        pthread_mutex_unlock(&heap_lock);
+        return;
+    }
+    if (in_thread_cache((void *)header_of_block - BOUNDRY_TAG_SIZE, index)) {
+        fprintf(stderr, "ERROR: pointer provide is Invalid as it is in the cache of this thread.\n");
+        abort();
+    }
+    if (local_cache.lists[index].length == THREAD_CACHE_MAX) {
+        pthread_mutex_lock(&heap_lock);
+        flush_thread_cache(index, THREAD_CACHE_BATCH);
+        pthread_mutex_unlock(&heap_lock);
+    }
+    if (!local_cache.registered) {
+        register_thread_cache();
+    }
+    // fast path: no lock
+    push_thread_cache(header_of_block, index, block_size);
+}
+
+void *sf_realloc(void *pp, size_t rsize) {
+    if (!thread_safe) {
+        return heap_realloc(pp, rsize);
+    }
+    pthread_mutex_lock(&heap_lock);
+    void *new_address = heap_realloc(pp, rsize);
+    pthread_mutex_unlock(&heap_lock);
+    return new_address;
+}
+
+void sf_set_realloc_in_place(bool enable) {
+    realloc_in_place = enable;
+}
+
+void sf_set_large_threshold(size_t size) {
+    large_threshold = size;
+}
+
+void sf_set_heap_growth(unsigned int percent) {
+    heap_growth = percent;
+}
+
+int sf_set_tlsf(bool enable) {
+    if (sf_mem_start() != sf_mem_end()) {
+        return -1;
+    }
+    tlsf = enable;
+    return 0;
+}
+
+void sf_set_thread_safe(bool enable) {
+    if (thread_safe && !enable) {
+        pthread_mutex_lock(&heap_lock);
+        for (int i = 0; i < NUM_QUICK_LISTS; i++) {
+            flush_thread_cache(i, local_cache.lists[i].length);
+        }
+        pthread_mutex_unlock(&heap_lock);
+    }
+    thread_safe = enable;
+}
+
+// ------------------------   END OF PUBLIC ENTRY POINTS   ------------------------- //
+
 double sf_fragmentation() {
     fprintf(stderr, "ERROR: This function doesn't work as there's not way to track internal payload size.");
     return 0.0;
@@ -1,8 +1,12 @@
 #include <criterion/criterion.h>
 #include <errno.h>
 #include <signal.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include "debug.h"
 #include "sfmm.h"
+#include "sfmm_ext.h"
+#include "__grading_helpers.h"
 #define TEST_TIMEOUT 15
 
 /*
@@ -812,3 +816,461 @@ Test(sfmm_student_suite, black_box_test_3, .timeout = TEST_TIMEOUT) {
 	double act_util = sf_utilization();
 	cr_assert(act_util == exp_util, "act_util = %f while expect value = %f", act_util, exp_util);
 }
+
+/**
+ * @brief once every block has been freed, check that none is left in the cache of some thread:
+ * a cached block looks allocated, so every block must be free or in a shared quick list.
+ */
+void assert_no_block_left_in_thread_cache() {
+	int marked = 0, listed = 0;
+	for (sf_block *bp = sf_mem_start() + 32; bp < (sf_block *)(sf_mem_end() - 16);
+		bp = (void *)bp + (xor_magic(bp->header) & ~0xf)) {
+		marked += (xor_magic(bp->header) & IN_QUICK_LIST) != 0;
+		cr_assert(!(xor_magic(bp->header) & THIS_BLOCK_ALLOCATED) || (xor_magic(bp->header) & IN_QUICK_LIST),
+			"Block %p is still allocated, or left in a thread cache", bp);
+	}
+	for (int i = 0; i < NUM_QUICK_LISTS; i++) {
+		listed += sf_quick_lists[i].length;
+	}
+	cr_assert_eq(marked, listed, "%d blocks are marked as in a quick list, but %d are in one",
+		marked, listed);
+}
+
+#define THREADS 4
+#define THREAD_SLOTS 16
+#define THREAD_ROUNDS 3000
+
+/**
+ * @brief allocate, fill, check, reallocate and free blocks of random sizes.
+ *
+ * @param arg
+ * 		the number of the thread, used as the fill byte and the seed.
+ * @return void*
+ * 		non-NULL if a block did not hold what was written to it, or could not be allocated.
+ */
+void *thread_workload(void *arg) {
+	unsigned char id = (unsigned char)(size_t)arg;
+	unsigned int seed = id;
+	unsigned char *slots[THREAD_SLOTS] = {0};
+	size_t sizes[THREAD_SLOTS] = {0};
+	void *failed = NULL;
+	for (int round = 0; round < THREAD_ROUNDS; round++) {
+		seed = seed * 1103515245 + 12345;
+		int slot = (seed >> 16) % THREAD_SLOTS;
+		size_t size = (seed >> 8) % 200 + 1;
+		if (slots[slot] == NULL) {
+			slots[slot] = sf_malloc(size);
+			if (slots[slot] == NULL)
+				return arg;
+			sizes[slot] = size;
+			memset(slots[slot], id, size);
+			continue;
+		}
+		for (size_t i = 0; i < sizes[slot]; i++)
+			if (slots[slot][i] != id)
+				failed = arg;
+		if (seed & 0x10000000) {
+			unsigned char *bigger = sf_realloc(slots[slot], sizes[slot] + size);
+			if (bigger == NULL)
+				return arg;
+			memset(bigger, id, sizes[slot] + size);
+			slots[slot] = bigger;
+			sizes[slot] += size;
+		} else {
+			sf_free(slots[slot]);
+			slots[slot] = NULL;
+		}
+	}
+	for (int slot = 0; slot < THREAD_SLOTS; slot++)
+		if (slots[slot] != NULL)
+			sf_free(slots[slot]);
+	return failed;
+}
+
+Test(sfmm_student_suite, thread_safe_concurrent, .timeout = TEST_TIMEOUT) {
+	sf_errno = 0;
+	sf_set_thread_safe(true);
+	pthread_t threads[THREADS];
+	for (size_t i = 0; i < THREADS; i++)
+		pthread_create(&threads[i], NULL, thread_workload, (void *)(i + 1));
+	for (int i = 0; i < THREADS; i++) {
+		void *failed;
+		pthread_join(threads[i], &failed);
+		cr_assert_null(failed, "Thread %d lost the contents of a block or ran out of memory", i + 1);
+	}
+	sf_set_thread_safe(false);
+
+	_assert_heap_is_valid();
+	assert_no_block_left_in_thread_cache();
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+Test(sfmm_student_suite, thread_cache_fast_path, .timeout = TEST_TIMEOUT) {
+	sf_errno = 0;
+	sf_set_thread_safe(true);
+	void *x = sf_malloc(40);
+	sf_free(x);
+	// the block stays in the cache of this thread instead of going to the shared quick list.
+	assert_quick_list_block_count(0, 0);
+	void *y = sf_malloc(40);
+	cr_assert(x == y, "The cached block was not reused (x=%p, y=%p)", x, y);
+	assert_allocate_bit_on(block_address_from_pointer(y));
+	sf_free(y);
+	sf_set_thread_safe(false);
+
+	// turning the mode off returns the cache to the shared heap.
+	cr_assert(sf_quick_lists[1].length != 0, "The cache was not returned to the quick list");
+	_assert_heap_is_valid();
+	assert_no_block_left_in_thread_cache();
+}
+
+/**
+ * @brief allocate and free more blocks of one size than a cache list holds, then exit.
+ */
+void *thread_fill_cache(void *arg) {
+	void *blocks[THREAD_CACHE_MAX + 4];
+	for (int i = 0; i < THREAD_CACHE_MAX + 4; i++)
+		blocks[i] = sf_malloc(100);
+	for (int i = 0; i < THREAD_CACHE_MAX + 4; i++)
+		sf_free(blocks[i]);
+	return NULL;
+}
+
+Test(sfmm_student_suite, thread_exit_flushes_cache, .timeout = TEST_TIMEOUT) {
+	sf_errno = 0;
+	sf_set_thread_safe(true);
+	pthread_t thread;
+	pthread_create(&thread, NULL, thread_fill_cache, NULL);
+	pthread_join(thread, NULL);
+	sf_set_thread_safe(false);
+
+	_assert_heap_is_valid();
+	assert_no_block_left_in_thread_cache();
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+Test(sfmm_student_suite, thread_cache_double_free, .timeout = TEST_TIMEOUT, .signal = SIGABRT) {
+	sf_set_thread_safe(true);
+	void *x = sf_malloc(40);
+	sf_free(x);
+	// x is in the cache of this thread, and its header still says it is allocated.
+	sf_free(x);
+}
+
+/**
+ * @brief allocate, fill and free blocks, half of cached sizes and half of sizes that are freed
+ * into the heap under the lock, so that the neighbours of cached blocks keep changing.
+ */
+void *thread_mixed_workload(void *arg) {
+	unsigned char id = (unsigned char)(size_t)arg;
+	unsigned int seed = id;
+	unsigned char *slots[THREAD_SLOTS * 2] = {0};
+	size_t sizes[THREAD_SLOTS * 2] = {0};
+	void *failed = NULL;
+	for (int round = 0; round < THREAD_ROUNDS * 4; round++) {
+		seed = seed * 1103515245 + 12345;
+		int slot = (seed >> 16) % (THREAD_SLOTS * 2);
+		if (slots[slot] != NULL) {
+			for (size_t i = 0; i < sizes[slot]; i++)
+				if (slots[slot][i] != id)
+					failed = arg;
+			sf_free(slots[slot]);
+			slots[slot] = NULL;
+			continue;
+		}
+		size_t size = seed & 0x100 ? (seed >> 9) % 150 + 1 : (seed >> 9) % 600 + 200;
+		slots[slot] = sf_malloc(size);
+		if (slots[slot] == NULL)
+			return arg;
+		sizes[slot] = size;
+		memset(slots[slot], id, size);
+	}
+	for (int slot = 0; slot < THREAD_SLOTS * 2; slot++)
+		if (slots[slot] != NULL)
+			sf_free(slots[slot]);
+	return failed;
+}
+
+/*
+ * Also meant to be run under ThreadSanitizer (make tsan), which reports any access to a header
+ * that is not ordered by heap_lock or made atomically.
+ */
+Test(sfmm_student_suite, thread_safe_mixed_sizes, .timeout = TEST_TIMEOUT * 4) {
+	sf_errno = 0;
+	sf_set_thread_safe(true);
+	pthread_t threads[THREADS];
+	for (size_t i = 0; i < THREADS; i++)
+		pthread_create(&threads[i], NULL, thread_mixed_workload, (void *)(i + 1));
+	for (int i = 0; i < THREADS; i++) {
+		void *failed;
+		pthread_join(threads[i], &failed);
+		cr_assert_null(failed, "Thread %d lost the contents of a block or ran out of memory", i + 1);
+	}
+	sf_set_thread_safe(false);
+
+	_assert_heap_is_valid();
+	assert_no_block_left_in_thread_cache();
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+// the same, with the sizes from 512 mapped on their own: the lock-free path of sf_free tells them
+// from heap blocks while other threads map and unmap large objects and grow the heap.
+Test(sfmm_student_suite, thread_safe_large_objects, .timeout = TEST_TIMEOUT * 4) {
+	sf_errno = 0;
+	sf_set_large_threshold(512);
+	sf_set_thread_safe(true);
+	pthread_t threads[THREADS];
+	for (size_t i = 0; i < THREADS; i++)
+		pthread_create(&threads[i], NULL, thread_mixed_workload, (void *)(i + 1));
+	for (int i = 0; i < THREADS; i++) {
+		void *failed;
+		pthread_join(threads[i], &failed);
+		cr_assert_null(failed, "Thread %d lost the contents of a block or ran out of memory", i + 1);
+	}
+	sf_set_thread_safe(false);
+
+	_assert_heap_is_valid();
+	assert_no_block_left_in_thread_cache();
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+Test(sfmm_student_suite, malloc_from_next_nonempty_list, .timeout = TEST_TIMEOUT) {
+	sf_errno = 0;
+	void *a = sf_malloc(300); // 320, list 4
+	/* void *b = */ sf_malloc(8);
+	void *c = sf_malloc(2000); // 2016, list 6
+	/* void *d = */ sf_malloc(8);
+	sf_free(a);
+	sf_free(c);
+	assert_free_list_size(4, 1);
+	assert_free_list_size(5, 0);
+	assert_free_list_size(6, 1);
+
+	// 416 starts at list 4, whose only block is too small; list 5 is empty, so c's block is split.
+	void *x = sf_malloc(400);
+	cr_assert(x == c, "Block was not taken from the next non-empty list (x=%p, c=%p)", x, c);
+	// the remainder, 1600, is back in list 6.
+	assert_free_list_size(4, 1);
+	assert_free_list_size(6, 1);
+	assert_free_block_count(2016 - 416, 1);
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+/**
+ * @brief walk the heap in TLSF mode, where the free blocks are not in sf_free_list_heads: check
+ * that every free block has a matching footer, and that no two free blocks are next to each other.
+ */
+void assert_tlsf_heap_is_valid() {
+	_assert_free_list_is_empty();
+	int prev_free = 0;
+	sf_block *bp;
+	for (bp = sf_mem_start() + 32; bp < (sf_block *)(sf_mem_end() - 16);
+		bp = (void *)bp + (xor_magic(bp->header) & ~0xf)) {
+		size_t size = xor_magic(bp->header) & ~0xf;
+		int is_free = !(xor_magic(bp->header) & THIS_BLOCK_ALLOCATED);
+		cr_assert(size >= 32 && (size & 0xf) == 0, "Block %p has invalid size %ld", bp, size);
+		if (is_free) {
+			sf_block *next = (void *)bp + size;
+			cr_assert(next->prev_footer == bp->header, "Free block %p has no matching footer", bp);
+			cr_assert(!prev_free, "Free block %p was not coalesced with the one before it", bp);
+		}
+		prev_free = is_free;
+	}
+	cr_assert(bp == (sf_block *)(sf_mem_end() - 16), "Could not traverse entire heap");
+}
+
+Test(sfmm_student_suite, tlsf_good_fit, .timeout = TEST_TIMEOUT) {
+	sf_errno = 0;
+	cr_assert_eq(sf_set_tlsf(true), 0, "TLSF mode could not be turned on");
+	void *a = sf_malloc(624); // 640
+	/* void *b = */ sf_malloc(8);
+	void *c = sf_malloc(992); // 1008
+	/* void *d = */ sf_malloc(8);
+	sf_free(a);
+	sf_free(c);
+
+	// both blocks are in [512, 1024), the class first fit would search from its most recent
+	// block, c; the second level separates them, and a's list is the first large enough for 608.
+	void *x = sf_malloc(600);
+	cr_assert(x == a, "The smaller fitting block was not chosen (x=%p, a=%p)", x, a);
+	assert_block_size(block_address_from_pointer(x), 608);
+	assert_tlsf_heap_is_valid();
+	cr_assert_eq(sf_set_tlsf(false), -1, "The mode of a heap in use was changed");
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+Test(sfmm_student_suite, tlsf_workload, .timeout = TEST_TIMEOUT) {
+	sf_errno = 0;
+	cr_assert_eq(sf_set_tlsf(true), 0, "TLSF mode could not be turned on");
+	cr_assert_null(thread_workload((void *)1), "A block lost its contents or could not be allocated");
+	assert_tlsf_heap_is_valid();
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+Test(sfmm_student_suite, grow_by_needed_pages, .timeout = TEST_TIMEOUT) {
+	sf_errno = 0;
+	// 5 pages past the first one are needed, the block at the end of the first included.
+	void *x = sf_malloc(PAGE_SZ * 5);
+	cr_assert_not_null(x, "x is NULL!");
+	cr_assert_eq(sf_mem_end() - sf_mem_start(), PAGE_SZ * 6, "The heap did not grow by 5 pages");
+	assert_free_block_count(0, 1);
+	assert_free_block_count(PAGE_SZ * 6 - 48 - (PAGE_SZ * 5 + 16), 1);
+	_assert_heap_is_valid();
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+Test(sfmm_student_suite, grow_by_policy, .timeout = TEST_TIMEOUT) {
+	sf_errno = 0;
+	sf_set_heap_growth(300);
+	/* void *x = */ sf_malloc(8000); // 8016 of the 8144 of the first page
+	// one page is needed, but the heap grows by 300% of its one page.
+	void *y = sf_malloc(200);
+	cr_assert_not_null(y, "y is NULL!");
+	cr_assert_eq(sf_mem_end() - sf_mem_start(), PAGE_SZ * 4, "The heap did not grow by 3 pages");
+	assert_free_block_count(0, 1);
+	assert_free_block_count(128 + PAGE_SZ * 3 - 208, 1);
+
+	// one more page is needed, 1000% of 4 pages is beyond the limit of the heap, which grows as far as it can.
+	sf_set_heap_growth(1000);
+	void *z = sf_malloc(PAGE_SZ * 4);
+	cr_assert_not_null(z, "z is NULL!");
+	void *limit = sf_mem_grow();
+	cr_assert_null(limit, "The heap did not grow as far as it could");
+	_assert_heap_is_valid();
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+/**
+ * @brief assert that the pages of a large object are mapped or not.
+ */
+void assert_mapped(void *address, int mapped) {
+	int ret = msync(address, 1, MS_ASYNC);
+	cr_assert_eq(ret == 0, mapped, "%p is %s", address, mapped ? "not mapped" : "still mapped");
+}
+
+Test(sfmm_student_suite, large_object_outside_heap, .timeout = TEST_TIMEOUT) {
+	sf_errno = 0;
+	sf_set_large_threshold(PAGE_SZ * 4);
+	void *x = sf_malloc(32);
+	void *heap_start = sf_mem_start(), *heap_end = sf_mem_end();
+
+	// more than the heap could ever hold.
+	char *y = sf_malloc(PAGE_SZ * 100);
+	cr_assert_not_null(y, "y is NULL!");
+	cr_assert(((void *)y < heap_start || (void *)y >= heap_end), "y is in the heap");
+	cr_assert(heap_start == sf_mem_start() && heap_end == sf_mem_end(), "The heap has changed");
+	memset(y, 0xa5, PAGE_SZ * 100);
+	// a request below the threshold still comes from the heap.
+	void *z = sf_malloc(PAGE_SZ * 4 - 1);
+	cr_assert((z > heap_start && z < sf_mem_end()), "z is not in the heap");
+
+	sf_free(y);
+	assert_mapped(y, 0);
+	sf_free(z);
+	sf_free(x);
+	_assert_heap_is_valid();
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+Test(sfmm_student_suite, large_object_realloc, .timeout = TEST_TIMEOUT) {
+	sf_errno = 0;
+	sf_set_large_threshold(PAGE_SZ * 4);
+	char *x = sf_malloc(1000);
+	for (int i = 0; i < 1000; i++)
+		x[i] = i;
+
+	// out of the heap, resized by remapping, then back into the heap.
+	char *y = sf_realloc(x, PAGE_SZ * 8);
+	cr_assert((void *)y < sf_mem_start() || (void *)y >= sf_mem_end(), "y is in the heap");
+	memset(y + 1000, 0x5a, PAGE_SZ * 8 - 1000);
+	char *z = sf_realloc(y, PAGE_SZ * 300);
+	cr_assert_not_null(z, "z is NULL!");
+	z[PAGE_SZ * 300 - 1] = 1;
+	char *w = sf_realloc(z, 2000);
+	cr_assert(((void *)w > sf_mem_start() && (void *)w < sf_mem_end()), "w is not in the heap");
+	assert_mapped(z, 0);
+	for (int i = 0; i < 2000; i++)
+		cr_assert_eq(w[i], i < 1000 ? (char)i : 0x5a, "Byte %d was lost", i);
+
+	// a large object freed by sf_realloc(pp, 0).
+	void *v = sf_malloc(PAGE_SZ * 5);
+	cr_assert_null(sf_realloc(v, 0), "sf_realloc(pp, 0) did not return NULL");
+	assert_mapped(v, 0);
+	sf_free(w);
+	_assert_heap_is_valid();
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+Test(sfmm_student_suite, realloc_grow_into_next_free_block, .timeout = TEST_TIMEOUT) {
+	sf_errno = 0;
+	sf_set_realloc_in_place(true);
+	char *x = sf_malloc(200); // 208
+	void *y = sf_malloc(300); // 320
+	/* void *z = */ sf_malloc(8);
+	for (int i = 0; i < 200; i++)
+		x[i] = i;
+	sf_free(y);
+
+	// 416 fits in 208 + 320, and the 112 left over is split off.
+	char *w = sf_realloc(x, 400);
+	cr_assert(w == x, "The block was moved (w=%p, x=%p)", w, x);
+	assert_block_size(block_address_from_pointer(w), 416);
+	assert_free_block_count(320, 0);
+	assert_free_block_count(112, 1);
+	for (int i = 0; i < 200; i++)
+		cr_assert_eq(w[i], (char)i, "Byte %d was lost", i);
+	_assert_heap_is_valid();
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+Test(sfmm_student_suite, realloc_in_place_to_large_threshold, .timeout = TEST_TIMEOUT) {
+	sf_errno = 0;
+	sf_set_realloc_in_place(true);
+	sf_set_large_threshold(400);
+	char *x = sf_malloc(200); // 208
+	void *y = sf_malloc(300); // 320
+	/* void *z = */ sf_malloc(8);
+	for (int i = 0; i < 200; i++)
+		x[i] = i;
+	sf_free(y);
+
+	// below the threshold, x grows in place into y.
+	char *v = sf_realloc(x, 350);
+	cr_assert(v == x, "The block was moved (v=%p, x=%p)", v, x);
+	assert_block_size(block_address_from_pointer(v), 368);
+
+	// at the threshold it moves out of the heap, though the 528 around it would still do.
+	char *w = sf_realloc(v, 400);
+	cr_assert((void *)w < sf_mem_start() || (void *)w >= sf_mem_end(), "w is in the heap");
+	assert_free_block_count(528, 1);
+	for (int i = 0; i < 200; i++)
+		cr_assert_eq(w[i], (char)i, "Byte %d was lost", i);
+	sf_free(w);
+	assert_mapped(w, 0);
+	_assert_heap_is_valid();
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+Test(sfmm_student_suite, realloc_grow_at_end_of_heap, .timeout = TEST_TIMEOUT) {
+	sf_errno = 0;
+	sf_set_realloc_in_place(true);
+	void *x = sf_malloc(8000); // 8016, followed by the last 128 of the page
+
+	// 24592 needs 3 more pages, which join the free block after x.
+	void *w = sf_realloc(x, PAGE_SZ * 3);
+	cr_assert(w == x, "The block was moved (w=%p, x=%p)", w, x);
+	assert_block_size(block_address_from_pointer(w), 24592);
+	cr_assert_eq(sf_mem_end() - sf_mem_start(), PAGE_SZ * 4, "The heap did not grow by 3 pages");
+	assert_free_block_count(0, 1);
+	assert_free_block_count(8016 + 128 + PAGE_SZ * 3 - 24592, 1);
+	_assert_heap_is_valid();
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}
+
+Test(sfmm_student_suite, realloc_in_place_workload, .timeout = TEST_TIMEOUT) {
+	sf_errno = 0;
+	sf_set_realloc_in_place(true);
+	cr_assert_null(thread_workload((void *)1), "A block lost its contents or could not be allocated");
+	_assert_heap_is_valid();
+	cr_assert(sf_errno == 0, "sf_errno is not zero!");
+}